@@ -0,0 +1,655 @@
+
+#ifndef __JUSTBASICTHREADPOOL_H__
+#define __JUSTBASICTHREADPOOL_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <functional>
+#include <type_traits>
+
+#include "JustConfig.hpp"
+#include "JustTask.hpp"
+#include "JustIdle.hpp"
+#include "JustMetrics.hpp"
+#include "JustConcurrentQueue.hpp"
+#include "JustCQ.hpp"
+#include "JustBoundedQueue.hpp"
+
+
+namespace Just{
+
+namespace policy{
+
+/**
+ * @brief 队列策略: ConcurrentQueue, 链表
+ *
+ * 队列策略的接口为 queue<T>, 提供 bool push(T&&), bool pop(T&), size_t size() const.
+ * push 返回 false 时不能移走参数, 线程池让出后重试.
+ * ThreadPool 的共享队列使用 LinkedQueue 与 BlockQueue, 另外需要消费者令牌 consumer 与 make_consumer(),
+ * size_t push_bulk(first, last), size_t pop_bulk(out, max, consumer&) 与 size_t clear().
+ */
+struct LinkedQueue
+{
+    template<typename T>
+    class queue
+    {
+        ConcurrentQueue<T> _queue;
+
+    public:
+        struct consumer {}; // 链表队列不需要消费者令牌
+
+        consumer make_consumer() noexcept
+        {
+            return consumer();
+        }
+
+        bool push(T&& v)
+        {
+            return _queue.push(std::move(v));
+        }
+
+        template<typename It>
+        size_t push_bulk(It first, It last)
+        {
+            return _queue.push_bulk(first, last);
+        }
+
+        bool pop(T& v)
+        {
+            return _queue.pop(v);
+        }
+
+        template<typename OutIt>
+        size_t pop_bulk(OutIt out, size_t max, consumer&)
+        {
+            return _queue.pop_bulk(out, max);
+        }
+
+        size_t size() const noexcept
+        {
+            int32_t count = _queue.size();
+            return count > 0 ? static_cast<size_t>(count) : 0;
+        }
+
+        size_t clear()
+        {
+            return _queue.clear();
+        }
+    };
+};
+
+/**
+ * @brief 队列策略: ConcurrentQueue2, 按块分配, 每个提交线程一个子队列
+ *
+ */
+struct BlockQueue
+{
+    template<typename T>
+    class queue
+    {
+        ConcurrentQueue2<T> _queue;
+
+    public:
+        using consumer = typename ConcurrentQueue2<T>::Customer; // 记住上次取到元素的子队列
+
+        consumer make_consumer() noexcept
+        {
+            return consumer(_queue);
+        }
+
+        bool push(T&& v)
+        {
+            return _queue.push(std::move(v));
+        }
+
+        template<typename It>
+        size_t push_bulk(It first, It last)
+        {
+            return _queue.push_bulk(first, last);
+        }
+
+        bool pop(T& v)
+        {
+            return _queue.pop(v);
+        }
+
+        template<typename OutIt>
+        size_t pop_bulk(OutIt out, size_t max, consumer& c)
+        {
+            return c.pop_bulk(out, max);
+        }
+
+        size_t size() const noexcept
+        {
+            return _queue.size();
+        }
+
+        size_t clear()
+        {
+            return _queue.clear();
+        }
+    };
+};
+
+/**
+ * @brief 队列策略: BoundedQueue, 有界环形队列, 满时提交线程让出等待
+ *
+ * 所有线程都在任务中提交且队列已满时无法前进, 容量需要大于任务中一次提交的数量.
+ */
+template<size_t Capacity = 4096>
+struct RingQueue
+{
+    template<typename T>
+    class queue
+    {
+        BoundedQueue<T> _queue;
+
+    public:
+        queue()
+            : _queue(Capacity)
+        {}
+
+        bool push(T&& v)
+        {
+            return _queue.try_push(std::move(v));
+        }
+
+        bool pop(T& v)
+        {
+            return _queue.try_pop(v);
+        }
+
+        size_t size() const noexcept
+        {
+            return _queue.size();
+        }
+    };
+};
+
+/**
+ * @brief 统计策略: 不统计, 所有调用都是空函数
+ *
+ * 统计策略的接口, worker 为工作者的下标, 只有该工作者的线程调用:
+ *     void start(size_t workers);    // 创建线程之前调用
+ *     void enter(size_t worker);     // 线程开始运行
+ *     void executed(size_t worker);  // 取到任务, 执行之前
+ *     void empty_pop(size_t worker); // 没有取到任务
+ *     void park(size_t worker);      // 空闲策略即将休眠或 sleep
+ *     void unpark(size_t worker);    // 休眠结束
+ *     void leave(size_t worker);     // 线程退出
+ */
+struct NoMetrics
+{
+    void start(size_t) noexcept {}
+    void enter(size_t) noexcept {}
+    void executed(size_t) noexcept {}
+    void empty_pop(size_t) noexcept {}
+    void park(size_t) noexcept {}
+    void unpark(size_t) noexcept {}
+    void leave(size_t) noexcept {}
+};
+
+/**
+ * @brief 统计策略: 每个工作者各自计数, 只有该工作者写入
+ *
+ */
+class CountMetrics
+{
+    struct Counters
+    {
+        std::atomic<uint64_t> tasks;      // 执行的任务数
+        std::atomic<uint64_t> empty_pops; // 没有取到任务的次数
+        char _pad0[CACHE_LINE_SIZE - 2 * sizeof(std::atomic<uint64_t>)];
+    };
+
+    std::unique_ptr<Counters[]> _workers;
+    size_t _count;
+
+    static void bump(std::atomic<uint64_t>& counter) noexcept
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    uint64_t sum(std::atomic<uint64_t> Counters::* field) const noexcept
+    {
+        uint64_t total = 0;
+        for (size_t i = 0; i < _count; i++)
+            total += (_workers[i].*field).load(std::memory_order_relaxed);
+        return total;
+    }
+
+public:
+    CountMetrics() noexcept
+        : _count { 0 }
+    {}
+
+    void start(size_t workers)
+    {
+        _workers.reset(new Counters[workers]);
+        _count = workers;
+        for (size_t i = 0; i < workers; i++)
+        {
+            _workers[i].tasks.store(0, std::memory_order_relaxed);
+            _workers[i].empty_pops.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void enter(size_t) noexcept {}
+
+    void executed(size_t worker) noexcept
+    {
+        bump(_workers[worker].tasks);
+    }
+
+    void empty_pop(size_t worker) noexcept
+    {
+        bump(_workers[worker].empty_pops);
+    }
+
+    void park(size_t) noexcept {}
+    void unpark(size_t) noexcept {}
+    void leave(size_t) noexcept {}
+
+    uint64_t tasks() const noexcept
+    {
+        return sum(&Counters::tasks);
+    }
+
+    uint64_t empty_pops() const noexcept
+    {
+        return sum(&Counters::empty_pops);
+    }
+};
+
+/**
+ * @brief 统计策略: 在计数之外统计每个工作者忙碌, 空闲与休眠的时间, ThreadPool 使用
+ *
+ * 只在忙碌与空闲切换时读取时钟. 窃取计数与采样任务的排队, 执行耗时由 ThreadPool 另外调用,
+ * snapshot 随时读取.
+ */
+class TimedMetrics
+{
+    struct Histogram
+    {
+        std::atomic<uint64_t> buckets[LatencyHistogram::BUCKETS];
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> total_ns;
+        std::atomic<uint64_t> max_ns;
+
+        Histogram() noexcept
+            : count { 0 }
+            , total_ns { 0 }
+            , max_ns { 0 }
+        {
+            for (auto& it : buckets)
+                it.store(0, std::memory_order_relaxed);
+        }
+    };
+
+    // 前后各填充一个缓存行, 不与相邻的工作者共享
+    struct Counters
+    {
+        char _pad0[CACHE_LINE_SIZE];
+        std::atomic<uint64_t> tasks;
+        std::atomic<uint64_t> busy_ns;
+        std::atomic<uint64_t> idle_ns;
+        std::atomic<uint64_t> parked_ns;
+        std::atomic<uint64_t> failed_pops;
+        std::atomic<uint64_t> steals;
+        std::atomic<uint64_t> failed_steals;
+        Histogram queue_wait;
+        Histogram execution;
+        int64_t since;                        // 当前状态开始的时间
+        bool busy;
+        char _pad1[CACHE_LINE_SIZE];
+
+        Counters() noexcept
+            : tasks { 0 }
+            , busy_ns { 0 }
+            , idle_ns { 0 }
+            , parked_ns { 0 }
+            , failed_pops { 0 }
+            , steals { 0 }
+            , failed_steals { 0 }
+            , since { 0 }
+            , busy { false }
+        {}
+    };
+
+    std::unique_ptr<Counters[]> _workers;
+    size_t _count;
+
+    // 只有一个线程写入的计数, load + store 不产生带 lock 前缀的指令
+    static void bump(std::atomic<uint64_t>& counter, uint64_t value = 1) noexcept
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    static void record(Histogram& hist, int64_t elapsed) noexcept
+    {
+        uint64_t ns = elapsed > 0 ? static_cast<uint64_t>(elapsed) : 0;
+        bump(hist.buckets[LatencyHistogram::bucket_of(ns)]);
+        bump(hist.count);
+        bump(hist.total_ns, ns);
+        if (ns > hist.max_ns.load(std::memory_order_relaxed))
+            hist.max_ns.store(ns, std::memory_order_relaxed);
+    }
+
+    static void snapshot(const Histogram& hist, LatencyHistogram& out) noexcept
+    {
+        for (size_t i = 0; i < LatencyHistogram::BUCKETS; i++)
+            out.buckets[i] = hist.buckets[i].load(std::memory_order_relaxed);
+        out.count = hist.count.load(std::memory_order_relaxed);
+        out.total_ns = hist.total_ns.load(std::memory_order_relaxed);
+        out.max_ns = hist.max_ns.load(std::memory_order_relaxed);
+    }
+
+    // 把当前状态持续的时间计入 elapsed, 返回当前时间
+    static int64_t account(Counters& c, std::atomic<uint64_t>& elapsed) noexcept
+    {
+        int64_t current = now();
+        bump(elapsed, static_cast<uint64_t>(current - c.since));
+        c.since = current;
+        return current;
+    }
+
+    static void set_busy(Counters& c, bool value) noexcept
+    {
+        account(c, c.busy ? c.busy_ns : c.idle_ns);
+        c.busy = value;
+    }
+
+public:
+    TimedMetrics() noexcept
+        : _count { 0 }
+    {}
+
+    static int64_t now() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void start(size_t workers)
+    {
+        _workers.reset(new Counters[workers]);
+        _count = workers;
+    }
+
+    void enter(size_t worker) noexcept
+    {
+        _workers[worker].since = now();
+        _workers[worker].busy = false;
+    }
+
+    void executed(size_t worker) noexcept
+    {
+        Counters& c = _workers[worker];
+        if (!c.busy)
+            set_busy(c, true);
+        bump(c.tasks);
+    }
+
+    void empty_pop(size_t worker) noexcept
+    {
+        Counters& c = _workers[worker];
+        bump(c.failed_pops);
+        if (c.busy)
+            set_busy(c, false);
+    }
+
+    void park(size_t worker) noexcept
+    {
+        account(_workers[worker], _workers[worker].idle_ns);
+    }
+
+    void unpark(size_t worker) noexcept
+    {
+        account(_workers[worker], _workers[worker].parked_ns);
+    }
+
+    void leave(size_t worker) noexcept
+    {
+        Counters& c = _workers[worker];
+        account(c, c.busy ? c.busy_ns : c.idle_ns);
+    }
+
+    void stole(size_t worker) noexcept
+    {
+        bump(_workers[worker].steals);
+    }
+
+    void steal_failed(size_t worker) noexcept
+    {
+        bump(_workers[worker].failed_steals);
+    }
+
+    /**
+     * @brief 采样的任务开始执行, stamp 为入队时间, 返回开始时间
+     *
+     * 顺便结算当前状态的时间, 持续满载时不会等到空闲才更新.
+     */
+    int64_t sample_begin(size_t worker, int64_t stamp) noexcept
+    {
+        Counters& c = _workers[worker];
+        int64_t start = account(c, c.busy ? c.busy_ns : c.idle_ns);
+        record(c.queue_wait, start - stamp);
+        return start;
+    }
+
+    void sample_end(size_t worker, int64_t start) noexcept
+    {
+        record(_workers[worker].execution, now() - start);
+    }
+
+    void snapshot(size_t worker, WorkerMetrics& out, LatencyHistogram& queue_wait, LatencyHistogram& execution) const noexcept
+    {
+        const Counters& c = _workers[worker];
+        out.tasks = c.tasks.load(std::memory_order_relaxed);
+        out.busy_ns = c.busy_ns.load(std::memory_order_relaxed);
+        out.idle_ns = c.idle_ns.load(std::memory_order_relaxed);
+        out.parked_ns = c.parked_ns.load(std::memory_order_relaxed);
+        out.failed_pops = c.failed_pops.load(std::memory_order_relaxed);
+        out.steals = c.steals.load(std::memory_order_relaxed);
+        out.failed_steals = c.failed_steals.load(std::memory_order_relaxed);
+        snapshot(c.queue_wait, queue_wait);
+        snapshot(c.execution, execution);
+    }
+
+    size_t workers() const noexcept
+    {
+        return _count;
+    }
+};
+
+}
+
+namespace detail{
+
+// Task 可以直接保存 packaged_task; 要求可复制的任务类型 (如 std::function) 通过 shared_ptr 间接保存
+template<typename TaskType, typename R>
+TaskType make_packaged(std::packaged_task<R()>&& pkg_task, std::true_type /* move only */)
+{
+    return TaskType(std::move(pkg_task));
+}
+
+template<typename TaskType, typename R>
+TaskType make_packaged(std::packaged_task<R()>&& pkg_task, std::false_type /* move only */)
+{
+    auto shared = std::make_shared<std::packaged_task<R()>>(std::move(pkg_task));
+    return TaskType([shared]() { (*shared)(); });
+}
+
+}
+
+/**
+ * @brief 编译期组合的精简线程池, 全部在头文件中, 队列, 任务类型, 空闲策略与统计都是模板参数
+ *
+ * 所有线程共享一个队列, 没有优先级, 窃取, NUMA 与定时器; 需要这些功能时使用 ThreadPool.
+ * ThreadPool 的共享队列, 空闲与统计使用同样的策略: LinkedQueue / BlockQueue, DynamicIdle 与 TimedMetrics.
+ * 默认参数 (LinkedQueue, Task, SpinPark, NoMetrics) 下, 提交与执行的路径上没有虚调用或 pimpl 间接访问.
+ * TaskPolicy 为任务类型, 需要可以由可调用对象构造, 可移动, 可以无参调用.
+ */
+template<typename QueuePolicy = policy::LinkedQueue,
+         typename TaskPolicy = Task,
+         typename IdlePolicy = SpinPark,
+         typename MetricsPolicy = policy::NoMetrics>
+class BasicThreadPool final
+{
+    public:
+        using task_type = TaskPolicy;
+
+    private:
+        using Queue = typename QueuePolicy::template queue<TaskPolicy>;
+
+        Queue _queue;
+        IdlePolicy _idle;
+        MetricsPolicy _metrics;
+        std::atomic<bool> _stopping;
+        std::vector<std::thread> _threads;
+
+        void enqueue(TaskPolicy&& t)
+        {
+            while (!_queue.push(std::move(t)))
+            {
+                std::this_thread::yield();
+            }
+            _idle.notify_one();
+        }
+
+        void work_func(size_t index)
+        {
+            size_t round = 0;
+            TaskPolicy task;
+            auto ready = [this]() {
+                return _queue.size() != 0 || _stopping.load(std::memory_order_acquire);
+            };
+
+            _metrics.enter(index);
+            for (;;)
+            {
+                if (_queue.pop(task))
+                {
+                    round = 0;
+                    _metrics.executed(index);
+                    task();
+                    task = TaskPolicy();
+                    continue;
+                }
+
+                // 停止时先执行完队列中剩余的任务
+                if (_stopping.load(std::memory_order_acquire))
+                {
+                    if (_queue.size() == 0)
+                        break;
+                    continue;
+                }
+
+                _metrics.empty_pop(index);
+                if (!_idle.parks(round))
+                {
+                    _idle.idle(round, ready);
+                    continue;
+                }
+
+                _metrics.park(index);
+                _idle.idle(round, ready);
+                _metrics.unpark(index);
+            }
+            _metrics.leave(index);
+        }
+
+    public:
+        explicit BasicThreadPool(size_t thread_count = std::thread::hardware_concurrency())
+            : _stopping { false }
+        {
+            if (thread_count == 0)
+                thread_count = 1;
+
+            _metrics.start(thread_count);
+            _threads.reserve(thread_count);
+            for (size_t i = 0; i < thread_count; i++)
+            {
+                _threads.emplace_back(&BasicThreadPool::work_func, this, i);
+            }
+        }
+
+        /**
+         * @brief 等待已提交的任务全部执行完后退出所有线程
+         *
+         */
+        ~BasicThreadPool()
+        {
+            stop();
+        }
+
+        BasicThreadPool(BasicThreadPool&&) = delete;
+        BasicThreadPool(const BasicThreadPool&) = delete;
+        BasicThreadPool& operator=(BasicThreadPool&&) = delete;
+        BasicThreadPool& operator=(const BasicThreadPool&) = delete;
+
+        template<typename Func, typename... Args>
+        std::future<std::result_of_t<std::decay_t<Func>(std::decay_t<Args>...)>>
+            run(Func&& func, Args&&... args)
+        {
+            using ret_t = typename std::result_of_t<std::decay_t<Func>(std::decay_t<Args>...)>;
+            std::packaged_task<ret_t()> pkg_task(detail::make_invoker(std::forward<Func>(func), std::forward<Args>(args)...));
+            std::future<ret_t> fut = pkg_task.get_future();
+
+            enqueue(detail::make_packaged<TaskPolicy>(std::move(pkg_task), std::is_same<TaskPolicy, Task>{}));
+
+            return fut;
+        }
+
+        /**
+         * @brief 提交任务但不创建 future, 任务抛出的异常不会被捕获
+         *
+         */
+        template<typename Func, typename... Args>
+        void post(Func&& func, Args&&... args)
+        {
+            enqueue(TaskPolicy(detail::make_invoker(std::forward<Func>(func), std::forward<Args>(args)...)));
+        }
+
+        /**
+         * @brief 停止接收新任务, 执行完队列中的任务后等待所有线程退出, 之后不可再提交
+         *
+         */
+        void stop()
+        {
+            if (_stopping.exchange(true, std::memory_order_acq_rel))
+                return;
+
+            _idle.notify_all();
+            for (auto& it : _threads)
+            {
+                if (it.joinable())
+                    it.join();
+            }
+        }
+
+        size_t thread_count() const noexcept
+        {
+            return _threads.size();
+        }
+
+        size_t task_count() const noexcept
+        {
+            return _queue.size();
+        }
+
+        const MetricsPolicy& metrics() const noexcept
+        {
+            return _metrics;
+        }
+};
+
+}
+
+#endif // __JUSTBASICTHREADPOOL_H__
@@ -0,0 +1,173 @@
+
+#ifndef __JUSTBOUNDEDQUEUE_H__
+#define __JUSTBOUNDEDQUEUE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <atomic>
+#include <utility>
+#include <type_traits>
+
+#include "JustConfig.hpp"
+
+
+namespace Just{
+
+/**
+ * @brief 有界多生产者多消费者环形队列 (Vyukov)
+ *
+ * 容量向上取整为 2 的幂, 所有槽位在构造时一次性分配, 之后 push pop 不再分配内存.
+ * 每个槽位带一个序号: 序号等于位置时可写, 等于位置 + 1 时可读.
+ */
+template<typename T>
+class BoundedQueue final
+{
+    private:
+        struct Slot
+        {
+            std::atomic<size_t> _seq;
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type _data;
+
+            T* item() noexcept
+            {
+                return reinterpret_cast<T*>(&_data);
+            }
+        };
+
+        Slot* const _slots;
+        const size_t _mask;
+        char _pad0[CACHE_LINE_SIZE - sizeof(Slot*) - sizeof(size_t)];
+        std::atomic<size_t> _head; // 下一个出队位置
+        char _pad1[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+        std::atomic<size_t> _tail; // 下一个入队位置
+        char _pad2[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+
+        static size_t round_capacity(size_t capacity) noexcept
+        {
+            size_t cap = 2;
+            while (cap < capacity)
+                cap <<= 1;
+            return cap;
+        }
+
+        template<typename U>
+        bool emplace(U&& v)
+        {
+            Slot* slot = nullptr;
+            size_t pos = _tail.load(std::memory_order_relaxed);
+
+            for (;;)
+            {
+                slot = &_slots[pos & _mask];
+                size_t seq = slot->_seq.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+                if (diff == 0) {
+                    if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0) {
+                    return false; // 满
+                }
+                else {
+                    pos = _tail.load(std::memory_order_relaxed);
+                }
+            }
+
+            ::new (static_cast<void*>(slot->item())) T(std::forward<U>(v));
+            slot->_seq.store(pos + 1, std::memory_order_release);
+
+            return true;
+        }
+
+    public:
+        explicit BoundedQueue(size_t capacity)
+            : _slots { new Slot[round_capacity(capacity)] }
+            , _mask { round_capacity(capacity) - 1 }
+            , _head { 0 }
+            , _tail { 0 }
+        {
+            for (size_t i = 0; i <= _mask; i++)
+                _slots[i]._seq.store(i, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief 析构剩余元素, 需要停止所有 push pop
+         *
+         */
+        ~BoundedQueue()
+        {
+            size_t head = _head.load(std::memory_order_relaxed);
+            size_t tail = _tail.load(std::memory_order_relaxed);
+            for (; head != tail; ++head)
+                _slots[head & _mask].item()->~T();
+            delete[] _slots;
+        }
+
+        BoundedQueue(BoundedQueue&&) = delete;
+        BoundedQueue(const BoundedQueue&) = delete;
+        BoundedQueue& operator=(BoundedQueue&&) = delete;
+        BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+        bool try_push(const T& v)
+        {
+            return emplace(v);
+        }
+
+        bool try_push(T&& v)
+        {
+            return emplace(std::move(v));
+        }
+
+        bool try_pop(T& v)
+        {
+            Slot* slot = nullptr;
+            size_t pos = _head.load(std::memory_order_relaxed);
+
+            for (;;)
+            {
+                slot = &_slots[pos & _mask];
+                size_t seq = slot->_seq.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+
+                if (diff == 0) {
+                    if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0) {
+                    return false; // 空
+                }
+                else {
+                    pos = _head.load(std::memory_order_relaxed);
+                }
+            }
+
+            v = std::move(*slot->item());
+            slot->item()->~T();
+            slot->_seq.store(pos + _mask + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        size_t capacity() const noexcept
+        {
+            return _mask + 1;
+        }
+
+        bool empty() const noexcept
+        {
+            return size() == 0;
+        }
+
+        size_t size() const noexcept
+        {
+            size_t head = _head.load(std::memory_order_relaxed);
+            size_t tail = _tail.load(std::memory_order_relaxed);
+            return tail > head ? tail - head : 0;
+        }
+};
+
+}
+
+#endif // __JUSTBOUNDEDQUEUE_H__
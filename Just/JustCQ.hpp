@@ -2,207 +2,487 @@
 #ifndef __JUSTCQ_H__
 #define __JUSTCQ_H__
 
+#include <cstdint>
+#include <cstddef>
+#include <new>
 #include <atomic>
+#include <vector>
 #include <utility>
+#include <type_traits>
+
+#include "JustConfig.hpp"
+#include "JustThreadSlots.hpp"
 
 namespace Just{
 
 constexpr const uint32_t BLOCK_SIZE = (1 << 10);
 
-enum class Pos : uint16_t{
-    IN,
-    ON,
-    OUT,
-};
-
 template<typename T>
 struct Block
 {
+    using Storage = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
 
-    std::atomic_uint32_t _first;
-    std::atomic_uint32_t _last;
-    
-    Block* _next;
+    std::atomic_uint32_t _consumed; // 已经被取走并析构的元素个数, 等于 BLOCK_SIZE 时整块可以复用
+    Block* _next;                   // 生产者私有, 按使用顺序串联
 
-    std::atomic_bool _sflag[BLOCK_SIZE];
-    T _data[BLOCK_SIZE];
+    Storage _data[BLOCK_SIZE];
 
     Block():
-        _first(0),
-        _last(0),
+        _consumed(0),
         _next(nullptr)
     {}
 
     Block(Block& other) = delete;
     Block(Block&& other) = delete;
 
-    void clear()
+    T* slot(uint64_t index) noexcept
     {
-        _last.store(0, std::memory_order_relaxed);
-        _first.store(0, std::memory_order_relaxed);
+        return reinterpret_cast<T*>(_data + (index & (BLOCK_SIZE - 1)));
     }
+};
 
-    Pos push(T&& item)
+/**
+ * @brief 基于块的多生产者多消费者队列
+ *
+ * 每个生产者拥有独立的子队列 (单生产者多消费者), 元素连续写入 BLOCK_SIZE 大小的块中,
+ * 块被完全消费后由该生产者复用. 消费者依次轮询各个子队列.
+ * 不使用 Producer 令牌时, 每个线程会自动绑定一个隐式生产者.
+ */
+template<typename T>
+class ConcurrentQueue2
+{
+    using Block_t = Block<T>;
+
+    struct BlockTable
     {
-        uint32_t last = _last.fetch_add(1, std::memory_order_relaxed);
-        
-        if (last == BLOCK_SIZE)
-            return Pos::ON;
-        else if (last > BLOCK_SIZE)
-            return PStat::OUT_MEM;
+        size_t _mask;
+        std::atomic<Block_t*>* _blocks;
+
+        explicit BlockTable(size_t capacity)
+            : _mask { capacity - 1 }
+            , _blocks { new std::atomic<Block_t*>[capacity] }
+        {
+            for (size_t i = 0; i < capacity; i++)
+                _blocks[i].store(nullptr, std::memory_order_relaxed);
+        }
+
+        ~BlockTable()
+        {
+            delete[] _blocks;
+        }
+
+        size_t capacity() const noexcept
+        {
+            return _mask + 1;
+        }
+
+        Block_t* get(uint64_t block_index) const noexcept
+        {
+            return _blocks[block_index & _mask].load(std::memory_order_relaxed);
+        }
+
+        void set(uint64_t block_index, Block_t* block) noexcept
+        {
+            _blocks[block_index & _mask].store(block, std::memory_order_relaxed);
+        }
+    };
 
-        new (_data + last) T(std::move(item));
-        _sflag[last].store(true, std::memory_order_release);
+    /**
+     * @brief 单个生产者的子队列, 下标单调递增, 块号为 下标 / BLOCK_SIZE
+     *
+     */
+    struct SubQueue
+    {
+        std::atomic<uint64_t> _tail; // 生产者发布的位置
+        char _pad0[CACHE_LINE_SIZE - sizeof(std::atomic<uint64_t>)];
+        std::atomic<uint64_t> _head; // 消费者争抢的位置
+        char _pad1[CACHE_LINE_SIZE - sizeof(std::atomic<uint64_t>)];
+
+        std::atomic<BlockTable*> _table;
+        std::atomic<bool> _active;
+        SubQueue* _next;
+
+        // 以下只有生产者访问
+        Block_t* _front_block;
+        Block_t* _tail_block;
+        size_t _live_blocks;
+        std::vector<BlockTable*> _old_tables; // 消费者可能仍在读取旧表, 析构时统一释放
+
+        SubQueue()
+            : _tail { 0 }
+            , _head { 0 }
+            , _table { new BlockTable(32) }
+            , _active { true }
+            , _next { nullptr }
+            , _front_block { nullptr }
+            , _tail_block { nullptr }
+            , _live_blocks { 0 }
+        {}
+
+        ~SubQueue()
+        {
+            uint64_t head = _head.load(std::memory_order_relaxed);
+            uint64_t tail = _tail.load(std::memory_order_relaxed);
+            BlockTable* table = _table.load(std::memory_order_relaxed);
+            for (; head != tail; ++head)
+            {
+                table->get(head / BLOCK_SIZE)->slot(head)->~T();
+            }
 
-        return PStat::OK;
-    }
+            while (_front_block)
+            {
+                Block_t* next = _front_block->_next;
+                delete _front_block;
+                _front_block = next;
+            }
 
-    bool pop(T& item)
-    {
-        uint32_t first = 0;
-        uint32_t last = 0;
-        
-        first = _first.load(std::memory_order_relaxed);
-        do {
-            last = _last.load(std::memory_order_relaxed);
-            if (first >= last)
-                return false;
-            if (first >= BLOCK_SIZE)
-            {
-                clear();
-                return false;
+            delete table;
+            for (BlockTable* it : _old_tables)
+                delete it;
+        }
+
+        void next_block(uint64_t block_index)
+        {
+            Block_t* block = nullptr;
+            if (_front_block && _front_block != _tail_block
+                && _front_block->_consumed.load(std::memory_order_acquire) == BLOCK_SIZE)
+            {
+                // 最旧的块已经被完全消费, 直接复用
+                block = _front_block;
+                _front_block = block->_next;
+                block->_consumed.store(0, std::memory_order_relaxed);
+                block->_next = nullptr;
+            }
+            else
+            {
+                block = new Block_t;
+                ++_live_blocks;
+            }
+
+            BlockTable* table = _table.load(std::memory_order_relaxed);
+            if (_live_blocks > table->capacity())
+            {
+                // 在用的块超出表容量, 扩容后复制在用块的映射
+                BlockTable* bigger = new BlockTable(table->capacity() * 2);
+                for (uint64_t i = block_index - (_live_blocks - 1); i != block_index; ++i)
+                    bigger->set(i, table->get(i));
+                _old_tables.push_back(table);
+                table = bigger;
+                _table.store(table, std::memory_order_release);
+            }
+            table->set(block_index, block);
+
+            if (_tail_block)
+                _tail_block->_next = block;
+            else
+                _front_block = block;
+            _tail_block = block;
+        }
+
+        template<typename U>
+        void push(U&& item)
+        {
+            uint64_t tail = _tail.load(std::memory_order_relaxed);
+            if ((tail & (BLOCK_SIZE - 1)) == 0)
+                next_block(tail / BLOCK_SIZE);
+
+            ::new (static_cast<void*>(_tail_block->slot(tail))) T(std::forward<U>(item));
+            _tail.store(tail + 1, std::memory_order_release);
+        }
+
+        template<typename It>
+        size_t push_bulk(It first, It last)
+        {
+            const uint64_t begin = _tail.load(std::memory_order_relaxed);
+            uint64_t tail = begin;
+            for (; first != last; ++first, ++tail)
+            {
+                if ((tail & (BLOCK_SIZE - 1)) == 0)
+                    next_block(tail / BLOCK_SIZE);
+                ::new (static_cast<void*>(_tail_block->slot(tail))) T(std::move(*first));
             }
-            if (!_sflag[first].load(std::memory_order_acquire))
-                return false;
-        }while (!_first.compare_exchange_weak(first, first+1, std::memory_order_relaxed, std::memory_order_relaxed));
 
-        item = std::move(_data[first]);
-        _sflag[first].store(false, std::memory_order_relaxed);
+            _tail.store(tail, std::memory_order_release);
+            return static_cast<size_t>(tail - begin);
+        }
 
-        return true;
+        template<typename OutIt>
+        size_t pop_bulk(OutIt& out, size_t max)
+        {
+            uint64_t head = _head.load(std::memory_order_relaxed);
+            uint64_t count = 0;
+            do
+            {
+                uint64_t tail = _tail.load(std::memory_order_acquire);
+                if (head >= tail)
+                    return 0;
+                count = tail - head < max ? tail - head : max;
+            } while (!_head.compare_exchange_weak(head, head + count, std::memory_order_relaxed, std::memory_order_relaxed));
+
+            BlockTable* table = _table.load(std::memory_order_acquire);
+            Block_t* block = table->get(head / BLOCK_SIZE);
+            uint32_t block_count = 0;
+            for (uint64_t i = head; i != head + count; ++i)
+            {
+                if (i != head && (i & (BLOCK_SIZE - 1)) == 0)
+                {
+                    block->_consumed.fetch_add(block_count, std::memory_order_release);
+                    block = table->get(i / BLOCK_SIZE);
+                    block_count = 0;
+                }
+
+                T* item = block->slot(i);
+                *out = std::move(*item);
+                ++out;
+                item->~T();
+                ++block_count;
+            }
+            block->_consumed.fetch_add(block_count, std::memory_order_release);
+
+            return static_cast<size_t>(count);
+        }
+
+        size_t size() const noexcept
+        {
+            uint64_t head = _head.load(std::memory_order_relaxed);
+            uint64_t tail = _tail.load(std::memory_order_relaxed);
+            return tail > head ? static_cast<size_t>(tail - head) : 0;
+        }
+    };
+
+    std::atomic<SubQueue*> _sub_queues;
+    uint64_t _id;
+
+    SubQueue* acquire_sub_queue()
+    {
+        SubQueue* sub = _sub_queues.load(std::memory_order_acquire);
+        for (; sub; sub = sub->_next)
+        {
+            bool active = false;
+            if (!sub->_active.load(std::memory_order_relaxed)
+                && sub->_active.compare_exchange_strong(active, true, std::memory_order_acquire, std::memory_order_relaxed))
+                return sub;
+        }
+
+        sub = new SubQueue;
+        SubQueue* head = _sub_queues.load(std::memory_order_relaxed);
+        do
+        {
+            sub->_next = head;
+        } while (!_sub_queues.compare_exchange_weak(head, sub, std::memory_order_release, std::memory_order_relaxed));
+
+        return sub;
     }
 
-};
+    static void release_sub_queue(void* sub)
+    {
+        static_cast<SubQueue*>(sub)->_active.store(false, std::memory_order_release);
+    }
 
-template<typename T>
-class ConcurrentQueue2
-{
-    using Block_t = Block<T>;
-    Block_t* _tie_block;
+    SubQueue* implicit_sub_queue()
+    {
+        detail::ThreadSlotCache& cache = detail::thread_slot_cache();
+        SubQueue* sub = static_cast<SubQueue*>(cache.find(_id));
+        if (sub)
+            return sub;
+
+        sub = acquire_sub_queue();
+        cache.add(_id, sub, &ConcurrentQueue2::release_sub_queue);
+        return sub;
+    }
+
+    template<typename OutIt>
+    size_t pop_bulk_from(SubQueue*& start, OutIt& out, size_t max)
+    {
+        SubQueue* head = _sub_queues.load(std::memory_order_acquire);
+        if (!head)
+            return 0;
+        if (!start)
+            start = head;
+
+        // 从上次成功的子队列开始轮询一圈
+        SubQueue* sub = start;
+        do
+        {
+            size_t count = sub->pop_bulk(out, max);
+            if (count > 0)
+            {
+                start = sub;
+                return count;
+            }
+            sub = sub->_next ? sub->_next : head;
+        } while (sub != start);
+
+        return 0;
+    }
 
 public:
+    /**
+     * @brief 显式生产者令牌, 同一时间只能被一个线程使用
+     *
+     */
     class Producer
     {
-        std::atomic<Block_t*> _block;
-        friend class ConcurrentQueue2;
+        SubQueue* _sub;
 
         public:
-            Producer(Block_t* block):
-                _block(block)
+            explicit Producer(ConcurrentQueue2& queue):
+                _sub(queue.acquire_sub_queue())
             {}
 
-            bool push(T& item)
+            ~Producer()
             {
-                return push(T(item));
+                if (_sub)
+                    release_sub_queue(_sub);
             }
 
-            bool push(T&& item)
+            Producer(Producer&& other) noexcept:
+                _sub(other._sub)
             {
-                Block_t* block = _block.load(std::memory_order_relaxed);
-
-                while (true) {
-                    PStat ps = block->push(std::move(item));
-
-                    switch (ps) {
-                        case PStat::OK:
-                            goto end_label;
-                        case PStat::FULL:
-                            block = new_block();
-                            break;
-                        case PStat::OUT_MEM:
-                            block = _block.load(std::memory_order_relaxed);
-                            break;
-                        default:
-                            break;
-                    }
-                };
+                other._sub = nullptr;
+            }
 
-                end_label:
+            Producer(const Producer&) = delete;
+            Producer& operator=(Producer&&) = delete;
+            Producer& operator=(const Producer&) = delete;
 
+            bool push(const T& item)
+            {
+                _sub->push(item);
                 return true;
             }
-        
-        private:
-            Block_t* new_block()
-            {
-                Block_t* block = _block.load(std::memory_order_relaxed);
-                Block_t* next_block = block->_next;
 
-                if (next_block->_last.load(std::memory_order_relaxed) >= BLOCK_SIZE)
-                {
-                    Block_t* next_block = new Block_t;
-                    next_block->_next = block->_next;
-                    block->_next = next_block;
-                }
-
-                _block.store(next_block, std::memory_order_release);
+            bool push(T&& item)
+            {
+                _sub->push(std::move(item));
+                return true;
+            }
 
-                return next_block;
+            template<typename It>
+            size_t push_bulk(It first, It last)
+            {
+                return _sub->push_bulk(first, last);
             }
     };
 
+    /**
+     * @brief 消费者令牌, 记住上次取到元素的子队列, 同一时间只能被一个线程使用
+     *
+     */
     class Customer
     {
-        std::atomic<Block_t*> _block;
-        friend class ConcurrentQueue2;
+        ConcurrentQueue2* _queue;
+        SubQueue* _current;
 
         public:
-            Customer(Block_t* block):
-                _block(block)
-            {
-
-            }
+            explicit Customer(ConcurrentQueue2& queue):
+                _queue(&queue),
+                _current(nullptr)
+            {}
 
             bool pop(T& item)
             {
-                Block_t* block = _block.load(std::memory_order_relaxed);
-
-                while (true) {
-                    if (!block)
-                        return false;
-                    if (!block->pop(item))
-                        block = next_block();
-                };
-
-                return true;
+                T* out = &item;
+                return _queue->pop_bulk_from(_current, out, 1) == 1;
             }
 
-        private:
-            Block_t* next_block()
+            template<typename OutIt>
+            size_t pop_bulk(OutIt out, size_t max)
             {
-                Block_t* block = _block.load(std::memory_order_relaxed);
-                _block.store(block->_next);
-                
-                return (block == block->_next) ? nullptr : block->_next;
+                return max ? _queue->pop_bulk_from(_current, out, max) : 0;
             }
     };
 
     ConcurrentQueue2():
-        _tie_block(new Block_t)
+        _sub_queues(nullptr),
+        _id(detail::register_slot_owner())
     {
-        _tie_block->_next = _tie_block;
     }
 
-    void CreateProducer(Producer& p)
+    /**
+     * @brief 析构剩余元素并释放所有块, 需要停止所有 push pop
+     *
+     */
+    ~ConcurrentQueue2()
     {
-        p._block.store(_tie_block, std::memory_order_relaxed);
+        detail::unregister_slot_owner(_id);
+
+        SubQueue* sub = _sub_queues.load(std::memory_order_relaxed);
+        while (sub)
+        {
+            SubQueue* next = sub->_next;
+            delete sub;
+            sub = next;
+        }
     }
 
-    void CreateCustomer(Customer& c)
+    ConcurrentQueue2(ConcurrentQueue2&&) = delete;
+    ConcurrentQueue2(const ConcurrentQueue2&) = delete;
+    ConcurrentQueue2& operator=(ConcurrentQueue2&&) = delete;
+    ConcurrentQueue2& operator=(const ConcurrentQueue2&) = delete;
+
+    bool push(const T& item)
     {
-        c._block.store(_tie_block, std::memory_order_relaxed);
+        implicit_sub_queue()->push(item);
+        return true;
+    }
+
+    bool push(T&& item)
+    {
+        implicit_sub_queue()->push(std::move(item));
+        return true;
     }
 
+    template<typename It>
+    size_t push_bulk(It first, It last)
+    {
+        return implicit_sub_queue()->push_bulk(first, last);
+    }
+
+    bool pop(T& item)
+    {
+        SubQueue* start = nullptr;
+        T* out = &item;
+        return pop_bulk_from(start, out, 1) == 1;
+    }
+
+    template<typename OutIt>
+    size_t pop_bulk(OutIt out, size_t max)
+    {
+        SubQueue* start = nullptr;
+        return max ? pop_bulk_from(start, out, max) : 0;
+    }
+
+    /**
+     * @brief 取出并析构调用时已经在队列中的元素, 之后并发入队的元素保留
+     *
+     * @return size_t 析构的元素个数
+     */
+    size_t clear()
+    {
+        // 先全部取出再析构, 元素的析构函数中再出队时不会取走本次要清除的元素
+        const size_t limit = size();
+        std::vector<T> dropped;
+        T item;
+        while (dropped.size() < limit && pop(item))
+        {
+            dropped.push_back(std::move(item));
+        }
+        return dropped.size();
+    }
+
+    bool empty() const noexcept
+    {
+        return size() == 0;
+    }
+
+    size_t size() const noexcept
+    {
+        size_t count = 0;
+        for (SubQueue* sub = _sub_queues.load(std::memory_order_acquire); sub; sub = sub->_next)
+            count += sub->size();
+        return count;
+    }
 };
 
 }
@@ -0,0 +1,107 @@
+
+#ifndef __JUSTCANCEL_H__
+#define __JUSTCANCEL_H__
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <type_traits>
+
+
+namespace Just{
+
+/**
+ * @brief 取消标记的只读端, 随任务一起提交, 线程在执行任务前检查
+ *
+ * 默认构造的标记永远不会被取消.
+ */
+class CancelToken final
+{
+    private:
+        std::shared_ptr<const std::atomic<bool>> _state;
+
+    public:
+        CancelToken() noexcept = default;
+
+        explicit CancelToken(std::shared_ptr<const std::atomic<bool>> state) noexcept
+            : _state { std::move(state) }
+        {}
+
+        bool cancelled() const noexcept
+        {
+            return _state && _state->load(std::memory_order_acquire);
+        }
+};
+
+/**
+ * @brief 取消标记的写入端, 可以复制, 所有副本共享同一个状态
+ *
+ */
+class CancelSource final
+{
+    private:
+        std::shared_ptr<std::atomic<bool>> _state;
+
+    public:
+        CancelSource()
+            : _state { std::make_shared<std::atomic<bool>>(false) }
+        {}
+
+        CancelToken token() const noexcept
+        {
+            return CancelToken(_state);
+        }
+
+        /**
+         * @brief 取消所有携带该标记且尚未开始的任务, 已经开始的任务需要自己检查 token
+         *
+         * @return true 第一次取消
+         */
+        bool cancel() noexcept
+        {
+            return !_state->exchange(true, std::memory_order_acq_rel);
+        }
+
+        bool cancelled() const noexcept
+        {
+            return _state->load(std::memory_order_acquire);
+        }
+};
+
+namespace detail{
+
+/**
+ * @brief 执行前检查取消标记, 已取消时直接析构闭包, run 的 future 因此得到 broken_promise
+ *
+ */
+template<typename Func>
+class CancelInvoker
+{
+    CancelToken _token;
+    Func _func;
+
+public:
+    template<typename F>
+    CancelInvoker(CancelToken token, F&& func)
+        : _token { std::move(token) }
+        , _func { std::forward<F>(func) }
+    {}
+
+    void operator()()
+    {
+        if (!_token.cancelled())
+            _func();
+    }
+};
+
+template<typename Func>
+CancelInvoker<std::decay_t<Func>> make_cancellable(CancelToken token, Func&& func)
+{
+    return CancelInvoker<std::decay_t<Func>>(std::move(token), std::forward<Func>(func));
+}
+
+}
+
+}
+
+#endif // __JUSTCANCEL_H__
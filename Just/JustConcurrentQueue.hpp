@@ -6,6 +6,10 @@
 #include <new>
 #include <memory>
 #include <atomic>
+#include <vector>
+
+#include "JustConfig.hpp"
+#include "JustEpoch.hpp"
 
 
 namespace Just{
@@ -27,48 +31,47 @@ class ConcurrentQueue final
         using Node = TheNode<T>;
 
     private:
+        using Epoch = EpochDomain<Node>;
+
         std::atomic<int32_t> _size;
 
-        typename Node::AtomicPtr _del;
         typename Node::AtomicPtr _first;
         typename Node::AtomicPtr _last;
         Allocator allocator; 
+        std::atomic<size_t> _allocations; // 调用 allocator.allocate 的次数
+        Epoch _epoch; // 出队后摘下的节点经由纪元回收, 之后经本线程的弹匣或共享仓库复用
+
+        static void destroy_node(void* ctx, Node* node)
+        {
+            ConcurrentQueue* queue = static_cast<ConcurrentQueue*>(ctx);
+            node->~Node();
+            queue->allocator.deallocate(node, 1);
+        }
 
-        typename Node::Ptr get_new_node()
+        typename Node::Ptr get_new_node(typename Epoch::Record& record)
         {
-            typename Node::Ptr new_node = get_del_node();
+            typename Node::Ptr new_node = _epoch.reuse(record);
 
             if (!new_node) {
+                _allocations.fetch_add(1, std::memory_order_relaxed);
                 new_node = allocator.allocate(1);
+                ::new (static_cast<void*>(new_node)) Node();
             }
             new_node->_next.store(nullptr, std::memory_order_relaxed);
             
             return new_node;
         }
 
-        typename Node::Ptr get_del_node()
-        {
-            typename Node::Ptr del_node = _del.load(std::memory_order_relaxed);
-            typename Node::Ptr del_node_next = del_node->_next.load(std::memory_order_relaxed);
-            typename Node::Ptr first_node = _first.load(std::memory_order_relaxed);
-
-            if (del_node != first_node
-                && _del.compare_exchange_weak(del_node, del_node_next, std::memory_order_relaxed, std::memory_order_relaxed)) {
-                return del_node;
-            }
-            
-            return nullptr;
-        }
-
     public:
         ConcurrentQueue()
             : _size { 0 }
-            , _del { nullptr }
             , _first { nullptr }
             , _last { nullptr }
+            , _allocations { 1 }
+            , _epoch { &ConcurrentQueue::destroy_node, this }
         {
-            typename Node::Ptr ptr = new Node;
-            _del.store(ptr, std::memory_order_relaxed);
+            typename Node::Ptr ptr = allocator.allocate(1);
+            ::new (static_cast<void*>(ptr)) Node();
             _first.store(ptr, std::memory_order_relaxed);
             _last.store(ptr, std::memory_order_relaxed);
         }
@@ -79,13 +82,12 @@ class ConcurrentQueue final
          */
         ~ConcurrentQueue()
         {
-            clear();
-            typename Node::Ptr del_node = _del.load(std::memory_order_relaxed);
-            typename Node::Ptr del_node_next = nullptr;
-            while (del_node) {
-                del_node_next = del_node->_next.load(std::memory_order_relaxed);
-                allocator.deallocate(del_node, 1);
-                del_node = del_node_next;
+            typename Node::Ptr node = _first.load(std::memory_order_relaxed);
+            typename Node::Ptr node_next = nullptr;
+            while (node) {
+                node_next = node->_next.load(std::memory_order_relaxed);
+                destroy_node(this, node);
+                node = node_next;
             };
         }
 
@@ -97,7 +99,6 @@ class ConcurrentQueue final
         bool is_lock_free()
         {
             return (std::atomic_is_lock_free(&_size)
-                    && std::atomic_is_lock_free(&_del)
                     && std::atomic_is_lock_free(&_first)
                     && std::atomic_is_lock_free(&_last));
         }
@@ -110,40 +111,120 @@ class ConcurrentQueue final
         bool push(T&& v)
         {
             typename Node::Ptr last_node = nullptr;
-            typename Node::Ptr v_node = get_new_node();
+            typename Node::Ptr v_node = get_new_node(_epoch.local());
             if (nullptr == v_node)
                 return false;
 
             v_node->_val = std::move(v);
 
-            last_node = _last.exchange(v_node, std::memory_order_relaxed);
-            last_node->_next.store(v_node, std::memory_order_relaxed);
+            // last_node 的 _next 为空之前不可能被出队摘下, 生产者不需要进入临界区
+            last_node = _last.exchange(v_node, std::memory_order_acq_rel);
+            last_node->_next.store(v_node, std::memory_order_release);
             _size.fetch_add(1, std::memory_order_release);
 
             return true;
         }
 
+        /**
+         * @brief 批量入队, 先在本地串好节点链, 再通过一次 exchange 接到队尾
+         *
+         * @return size_t 入队的元素个数
+         */
+        template<typename It>
+        size_t push_bulk(It first, It last)
+        {
+            if (first == last)
+                return 0;
+
+            typename Epoch::Record& record = _epoch.local();
+            typename Node::Ptr head_node = get_new_node(record);
+            typename Node::Ptr tail_node = head_node;
+            size_t count = 1;
+
+            head_node->_val = std::move(*first);
+            for (++first; first != last; ++first, ++count)
+            {
+                typename Node::Ptr v_node = get_new_node(record);
+                v_node->_val = std::move(*first);
+                tail_node->_next.store(v_node, std::memory_order_relaxed);
+                tail_node = v_node;
+            }
+
+            typename Node::Ptr last_node = _last.exchange(tail_node, std::memory_order_acq_rel);
+            last_node->_next.store(head_node, std::memory_order_release);
+            _size.fetch_add(static_cast<int32_t>(count), std::memory_order_release);
+
+            return count;
+        }
+
         bool pop(T& v)
         {
             if (empty())
                 return false;
-            typename Node::Ptr first_node = _first.load(std::memory_order_relaxed);
+            typename Epoch::Record& record = _epoch.local();
+            typename Epoch::Guard guard(_epoch, record);
+            typename Node::Ptr first_node = _first.load(std::memory_order_acquire);
             typename Node::Ptr first_node_next = nullptr;
 
             do
             {
-                first_node_next = first_node->_next.load(std::memory_order_relaxed);
+                first_node_next = first_node->_next.load(std::memory_order_acquire);
                 if (nullptr == first_node_next)
                     return false;
-            } while (!(_first.compare_exchange_weak(first_node, first_node_next, std::memory_order_acquire, std::memory_order_relaxed)));
+            } while (!(_first.compare_exchange_weak(first_node, first_node_next, std::memory_order_seq_cst, std::memory_order_acquire)));
 
             _size.fetch_sub(1, std::memory_order_release);
+            // first_node_next 成为新的哑节点, 其他消费者摘下它时仍处于本线程的临界区, 不会被复用
             v = std::move(first_node_next->_val);
-            allocator.deallocate(get_del_node(), 1);
+            _epoch.retire(record, first_node);
 
             return true;
         }
 
+        /**
+         * @brief 批量出队, 沿链表最多取 max 个节点, 通过一次 CAS 移动头指针
+         *
+         * @return size_t 出队的元素个数
+         */
+        template<typename OutIt>
+        size_t pop_bulk(OutIt out, size_t max)
+        {
+            if (max == 0 || empty())
+                return 0;
+            typename Epoch::Record& record = _epoch.local();
+            typename Epoch::Guard guard(_epoch, record);
+            typename Node::Ptr first_node = _first.load(std::memory_order_acquire);
+            typename Node::Ptr new_first = nullptr;
+            size_t count = 0;
+
+            do
+            {
+                count = 0;
+                new_first = first_node;
+                for (typename Node::Ptr next = nullptr; count < max; ++count)
+                {
+                    next = new_first->_next.load(std::memory_order_acquire);
+                    if (nullptr == next)
+                        break;
+                    new_first = next;
+                }
+                if (count == 0)
+                    return 0;
+            } while (!(_first.compare_exchange_weak(first_node, new_first, std::memory_order_seq_cst, std::memory_order_acquire)));
+
+            _size.fetch_sub(static_cast<int32_t>(count), std::memory_order_release);
+            for (typename Node::Ptr node = first_node; node != new_first; )
+            {
+                typename Node::Ptr next = node->_next.load(std::memory_order_relaxed);
+                *out = std::move(next->_val);
+                ++out;
+                _epoch.retire(record, node);
+                node = next;
+            }
+
+            return count;
+        }
+
         bool empty() const noexcept
         {
             return size() <= 0;
@@ -155,14 +236,55 @@ class ConcurrentQueue final
         }
 
         /**
-         * @brief 强行将头指针指向尾指针
+         * @brief 构造以来向分配器申请节点的次数, 稳定运行时应当几乎不再增长
          *
          */
-        void clear() noexcept
+        size_t allocations() const noexcept
         {
-            typename Node::Ptr const last_node = _last.load(std::memory_order_relaxed);
-            typename Node::Ptr first_node = _first.exchange(last_node, std::memory_order_acquire);
-            int32_t clear_size = _size.exchange(0, std::memory_order_release);
+            return _allocations.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief 将头指针移到当时的尾节点, 析构跳过的元素, 节点交给纪元回收后复用
+         *
+         * 可以与 push pop 并发; _size 只减去实际摘下的元素个数, 与 push pop 各自的增减相互抵消.
+         * 元素在离开纪元临界区之后才析构: 析构可能执行任意代码, 其中再操作本队列会重复进入同一纪元记录.
+         * @return size_t 析构的元素个数
+         */
+        size_t clear()
+        {
+            std::vector<T> dropped;
+            {
+                typename Epoch::Record& record = _epoch.local();
+                typename Epoch::Guard guard(_epoch, record);
+                typename Node::Ptr first_node = _first.load(std::memory_order_acquire);
+                typename Node::Ptr last_node = nullptr;
+
+                // 头指针未变说明读取尾指针时 first_node 之后的节点都还没有被出队
+                do
+                {
+                    last_node = _last.load(std::memory_order_acquire);
+                } while (!(_first.compare_exchange_weak(first_node, last_node, std::memory_order_seq_cst, std::memory_order_acquire)));
+
+                while (first_node != last_node)
+                {
+                    typename Node::Ptr next = first_node->_next.load(std::memory_order_acquire);
+                    if (nullptr == next) {
+                        // 生产者已经交换了 _last 但还没有链接, 等待其完成
+                        cpu_relax();
+                        continue;
+                    }
+                    // next 的元素属于本次清除, 包括留作新哑节点的 last_node
+                    dropped.push_back(std::move(next->_val));
+                    _epoch.retire(record, first_node);
+                    first_node = next;
+                }
+            }
+
+            _size.fetch_sub(static_cast<int32_t>(dropped.size()), std::memory_order_release);
+            const size_t count = dropped.size();
+            dropped.clear();
+            return count;
         }
 };
 
@@ -0,0 +1,41 @@
+
+#ifndef __JUSTCONFIG_H__
+#define __JUSTCONFIG_H__
+
+#include <cstddef>
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#endif
+
+// 以 C++20 构建并定义 JUST_ENABLE_COROUTINES 时启用协程接口 (JustCoroutine.hpp, ThreadPool::schedule)
+#if defined(JUST_ENABLE_COROUTINES) && defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define JUST_HAS_COROUTINES 1
+#endif
+#endif
+
+
+namespace Just{
+
+// 缓存行大小, 用于隔离多线程频繁写入的字段, 避免伪共享
+constexpr const size_t CACHE_LINE_SIZE = 64;
+
+/**
+ * @brief 自旋等待时的 CPU 提示, 降低忙等对超线程兄弟核的影响
+ *
+ */
+inline void cpu_relax() noexcept
+{
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+    _mm_pause();
+#elif defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+
+}
+
+#endif // __JUSTCONFIG_H__
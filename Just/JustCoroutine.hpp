@@ -0,0 +1,547 @@
+
+#ifndef __JUSTCOROUTINE_H__
+#define __JUSTCOROUTINE_H__
+
+#include "JustConfig.hpp"
+
+#ifdef JUST_HAS_COROUTINES
+
+#include <cstddef>
+#include <array>
+#include <tuple>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <utility>
+#include <optional>
+#include <exception>
+#include <coroutine>
+#include <type_traits>
+#include <condition_variable>
+
+#include "JustFuture.hpp"
+#include "JustThreadPool.h"
+
+
+namespace Just{
+
+template<typename T = void>
+class task;
+
+namespace detail{
+
+struct TaskAccess;
+
+struct TaskPromiseBase
+{
+    struct FinalAwaiter
+    {
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        // 对称转移到等待者, 调用链再长也不会增加栈深度
+        template<typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            std::coroutine_handle<> next = handle.promise().continuation;
+            return next ? next : std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept
+        {}
+    };
+
+    std::coroutine_handle<> continuation;
+    std::exception_ptr exception;
+
+    std::suspend_always initial_suspend() const noexcept
+    {
+        return {};
+    }
+
+    FinalAwaiter final_suspend() const noexcept
+    {
+        return {};
+    }
+
+    void unhandled_exception() noexcept
+    {
+        exception = std::current_exception();
+    }
+};
+
+template<typename T>
+class TaskPromise final : public TaskPromiseBase
+{
+    private:
+        std::optional<T> _value;
+
+    public:
+        task<T> get_return_object() noexcept;
+
+        template<typename U = T, typename = std::enable_if_t<std::is_convertible<U&&, T>::value>>
+        void return_value(U&& value)
+        {
+            _value.emplace(std::forward<U>(value));
+        }
+
+        T result()
+        {
+            if (exception)
+                std::rethrow_exception(exception);
+            return std::move(*_value);
+        }
+};
+
+template<>
+class TaskPromise<void> final : public TaskPromiseBase
+{
+    public:
+        task<void> get_return_object() noexcept;
+
+        void return_void() const noexcept
+        {}
+
+        void result()
+        {
+            if (exception)
+                std::rethrow_exception(exception);
+        }
+};
+
+}
+
+/**
+ * @brief 惰性协程任务, 第一次 co_await 时才开始执行, 结束后恢复等待它的协程
+ *
+ * 与类型擦除的 Just::Task 不同, task<T> 是协程的返回类型. 只可移动, 析构时销毁协程帧.
+ * 需要切换到线程池时在协程内 co_await pool.schedule().
+ */
+template<typename T>
+class task final
+{
+    public:
+        using promise_type = detail::TaskPromise<T>;
+        using value_type = T;
+
+    private:
+        friend struct detail::TaskAccess;
+        std::coroutine_handle<promise_type> _handle;
+
+        struct Awaiter
+        {
+            std::coroutine_handle<promise_type> handle;
+
+            bool await_ready() const noexcept
+            {
+                return !handle || handle.done();
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+            {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+
+            T await_resume()
+            {
+                return handle.promise().result();
+            }
+        };
+
+    public:
+        task() noexcept = default;
+
+        explicit task(std::coroutine_handle<promise_type> handle) noexcept
+            : _handle { handle }
+        {}
+
+        task(task&& other) noexcept
+            : _handle { std::exchange(other._handle, nullptr) }
+        {}
+
+        task& operator=(task&& other) noexcept
+        {
+            if (this != &other) {
+                if (_handle)
+                    _handle.destroy();
+                _handle = std::exchange(other._handle, nullptr);
+            }
+            return *this;
+        }
+
+        task(const task&) = delete;
+        task& operator=(const task&) = delete;
+
+        ~task()
+        {
+            if (_handle)
+                _handle.destroy();
+        }
+
+        bool valid() const noexcept
+        {
+            return static_cast<bool>(_handle);
+        }
+
+        bool is_ready() const noexcept
+        {
+            return !_handle || _handle.done();
+        }
+
+        Awaiter operator co_await() && noexcept
+        {
+            return Awaiter { _handle };
+        }
+};
+
+namespace detail{
+
+template<typename T>
+task<T> TaskPromise<T>::get_return_object() noexcept
+{
+    return task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline task<void> TaskPromise<void>::get_return_object() noexcept
+{
+    return task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+/**
+ * @brief 等待一个 task 结束后调用 notify, 由 sync_wait 与 when_all 使用
+ *
+ * 结束时停在 final_suspend, 协程帧由持有者销毁, notify 中可以安全地释放等待者.
+ */
+class NotifyTask final
+{
+    public:
+        using Notify = void (*)(void* ctx);
+
+        struct promise_type
+        {
+            Notify notify = nullptr;
+            void* ctx = nullptr;
+
+            struct FinalAwaiter
+            {
+                bool await_ready() const noexcept
+                {
+                    return false;
+                }
+
+                void await_suspend(std::coroutine_handle<promise_type> handle) const noexcept
+                {
+                    promise_type& promise = handle.promise();
+                    promise.notify(promise.ctx);
+                }
+
+                void await_resume() const noexcept
+                {}
+            };
+
+            NotifyTask get_return_object() noexcept
+            {
+                return NotifyTask(std::coroutine_handle<promise_type>::from_promise(*this));
+            }
+
+            std::suspend_always initial_suspend() const noexcept
+            {
+                return {};
+            }
+
+            FinalAwaiter final_suspend() const noexcept
+            {
+                return {};
+            }
+
+            void return_void() const noexcept
+            {}
+
+            void unhandled_exception() const noexcept
+            {
+                // 被等待的 task 自己保存异常, 这里不会抛出
+                std::terminate();
+            }
+        };
+
+    private:
+        std::coroutine_handle<promise_type> _handle;
+
+    public:
+        NotifyTask() noexcept = default;
+
+        explicit NotifyTask(std::coroutine_handle<promise_type> handle) noexcept
+            : _handle { handle }
+        {}
+
+        NotifyTask(NotifyTask&& other) noexcept
+            : _handle { std::exchange(other._handle, nullptr) }
+        {}
+
+        NotifyTask& operator=(NotifyTask&& other) noexcept
+        {
+            if (this != &other) {
+                if (_handle)
+                    _handle.destroy();
+                _handle = std::exchange(other._handle, nullptr);
+            }
+            return *this;
+        }
+
+        ~NotifyTask()
+        {
+            if (_handle)
+                _handle.destroy();
+        }
+
+        void start(Notify notify, void* ctx)
+        {
+            _handle.promise().notify = notify;
+            _handle.promise().ctx = ctx;
+            _handle.resume();
+        }
+};
+
+struct TaskAccess
+{
+    // 只等待结束, 不取结果
+    template<typename T>
+    struct ReadyAwaiter
+    {
+        std::coroutine_handle<TaskPromise<T>> handle;
+
+        bool await_ready() const noexcept
+        {
+            return !handle || handle.done();
+        }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+        {
+            handle.promise().continuation = awaiting;
+            return handle;
+        }
+
+        void await_resume() const noexcept
+        {}
+    };
+
+    template<typename T>
+    static ReadyAwaiter<T> when_ready(task<T>& t) noexcept
+    {
+        return ReadyAwaiter<T> { t._handle };
+    }
+
+    /**
+     * @brief 取出已经结束的 task 的结果, void 时返回 Unit; 有异常时重新抛出
+     *
+     */
+    template<typename T>
+    static typename FutureValue<T>::type take(task<T>& t)
+    {
+        return take(t, std::is_void<T>{});
+    }
+
+    template<typename T>
+    static Unit take(task<T>& t, std::true_type /* void */)
+    {
+        t._handle.promise().result();
+        return Unit {};
+    }
+
+    template<typename T>
+    static T take(task<T>& t, std::false_type /* void */)
+    {
+        return t._handle.promise().result();
+    }
+};
+
+template<typename T>
+NotifyTask make_notify_task(task<T>& t)
+{
+    co_await TaskAccess::when_ready(t);
+}
+
+struct SyncEvent
+{
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool ready = false;
+
+    static void notify(void* ctx)
+    {
+        SyncEvent* self = static_cast<SyncEvent*>(ctx);
+        std::lock_guard<std::mutex> locker(self->mutex);
+        self->ready = true;
+        self->cond.notify_all();
+    }
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> locker(mutex);
+        cond.wait(locker, [this]() { return ready; });
+    }
+};
+
+/**
+ * @brief when_all 的计数器, 初值为子任务数加一, 多出的一份由等待者挂起后归还
+ *
+ */
+class WhenAllLatch final
+{
+    private:
+        std::atomic<size_t> _count;
+        std::coroutine_handle<> _awaiting;
+
+        static void arrive(void* ctx)
+        {
+            WhenAllLatch* self = static_cast<WhenAllLatch*>(ctx);
+            if (self->_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                self->_awaiting.resume();
+        }
+
+    public:
+        explicit WhenAllLatch(size_t count) noexcept
+            : _count { count + 1 }
+        {}
+
+        /**
+         * @brief 依次启动 waiters 并挂起, 全部结束后由最后一个结束的线程恢复等待者
+         *
+         */
+        template<typename Waiters>
+        auto wait(Waiters& waiters) noexcept
+        {
+            struct Awaiter
+            {
+                WhenAllLatch& latch;
+                Waiters& waiters;
+
+                bool await_ready() const noexcept
+                {
+                    return false;
+                }
+
+                bool await_suspend(std::coroutine_handle<> awaiting) noexcept
+                {
+                    latch._awaiting = awaiting;
+                    for (auto& it : waiters)
+                        it.start(&WhenAllLatch::arrive, &latch);
+                    // 全部已经同步完成时不挂起
+                    return latch._count.fetch_sub(1, std::memory_order_acq_rel) != 1;
+                }
+
+                void await_resume() const noexcept
+                {}
+            };
+            return Awaiter { *this, waiters };
+        }
+};
+
+template<typename T>
+class FutureAwaiter final
+{
+    private:
+        std::shared_ptr<FutureState<T>> _state;
+
+    public:
+        explicit FutureAwaiter(std::shared_ptr<FutureState<T>> state) noexcept
+            : _state { std::move(state) }
+        {}
+
+        bool await_ready() const noexcept
+        {
+            return _state->is_ready();
+        }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            // 与 then 一样回到 Future 所属的线程池恢复, 不在完成者的线程中执行用户代码
+            ThreadPool* pool = _state->pool();
+            _state->on_ready([pool, handle]() {
+                if (pool)
+                    pool->post([handle]() { handle.resume(); });
+                else
+                    handle.resume();
+            });
+        }
+
+        T await_resume()
+        {
+            return static_cast<T>(_state->take());
+        }
+};
+
+}
+
+/**
+ * @brief co_await future 等待 Future 的结果而不阻塞线程
+ *
+ */
+template<typename T>
+detail::FutureAwaiter<T> operator co_await(Future<T>&& future) noexcept
+{
+    return detail::FutureAwaiter<T>(std::move(detail::FutureAccess::state(future)));
+}
+
+/**
+ * @brief 在当前线程中启动 t 并阻塞等待结果, 不要在线程池的任务中调用
+ *
+ */
+template<typename T>
+T sync_wait(task<T> t)
+{
+    detail::SyncEvent event;
+    detail::NotifyTask waiter = detail::make_notify_task(t);
+    waiter.start(&detail::SyncEvent::notify, &event);
+    event.wait();
+    return static_cast<T>(detail::TaskAccess::take(t));
+}
+
+/**
+ * @brief 依次启动所有 task, 全部结束后得到各自的结果 (void 为 detail::Unit)
+ *
+ * 子任务在调用者的线程中开始执行, 遇到 co_await pool.schedule() 后才并发.
+ * 全部结束后才检查异常, 按参数顺序重新抛出第一个异常.
+ */
+template<typename... Ts>
+task<std::tuple<typename detail::FutureValue<Ts>::type...>> when_all(task<Ts>... tasks)
+{
+    std::array<detail::NotifyTask, sizeof...(Ts)> waiters { detail::make_notify_task(tasks)... };
+    detail::WhenAllLatch latch(sizeof...(Ts));
+    co_await latch.wait(waiters);
+    co_return std::tuple<typename detail::FutureValue<Ts>::type...> { detail::TaskAccess::take(tasks)... };
+}
+
+template<typename T>
+task<std::conditional_t<std::is_void<T>::value, void, std::vector<T>>> when_all(std::vector<task<T>> tasks)
+{
+    std::vector<detail::NotifyTask> waiters;
+    waiters.reserve(tasks.size());
+    for (auto& it : tasks)
+        waiters.push_back(detail::make_notify_task(it));
+
+    detail::WhenAllLatch latch(tasks.size());
+    co_await latch.wait(waiters);
+
+    if constexpr (std::is_void<T>::value) {
+        for (auto& it : tasks)
+            detail::TaskAccess::take(it);
+    }
+    else {
+        std::vector<T> result;
+        result.reserve(tasks.size());
+        for (auto& it : tasks)
+            result.push_back(detail::TaskAccess::take(it));
+        co_return result;
+    }
+}
+
+}
+
+#endif // JUST_HAS_COROUTINES
+
+#endif // __JUSTCOROUTINE_H__
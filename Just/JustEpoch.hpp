@@ -0,0 +1,317 @@
+
+#ifndef __JUSTEPOCH_H__
+#define __JUSTEPOCH_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <utility>
+
+#include "JustThreadSlots.hpp"
+
+
+namespace Just{
+
+/**
+ * @brief 基于纪元的内存回收 (EBR)
+ *
+ * 读取共享节点的线程进入临界区时公布当前纪元; 被摘下的节点先放入本线程按纪元分组的
+ * 退休列表, 当全局纪元前进两次后, 没有线程还能持有它们, 节点转入本线程的空闲列表复用.
+ * 每个线程在每个 EpochDomain 中有一个 Record, 线程退出后 Record 留给后来的线程使用.
+ *
+ * 空闲列表即本线程的弹匣: 超过 FREE_LIMIT 时把 MAGAZINE_SIZE 个节点整批放入共享仓库,
+ * 空闲列表为空时从仓库整批取回. 只退休不复用的线程 (消费者) 与只复用不退休的线程 (生产者)
+ * 之间因此可以循环使用节点, 仓库的锁每 MAGAZINE_SIZE 个节点才取一次.
+ */
+template<typename T>
+class EpochDomain final
+{
+    public:
+        using Destroy = void (*)(void* ctx, T* ptr);
+
+        static constexpr const size_t MAGAZINE_SIZE = 256;  // 与仓库交换的一批节点数
+        static constexpr const size_t FREE_LIMIT = 2 * MAGAZINE_SIZE; // 每个线程空闲列表的上限, 超出部分放入仓库
+        static constexpr const size_t DEPOT_LIMIT = 64;     // 仓库最多保存的弹匣数, 超出部分直接销毁
+        static constexpr const uint32_t ADVANCE_INTERVAL = 64; // 每退休多少个节点尝试推进一次纪元
+
+        struct Record
+        {
+            std::atomic<uint64_t> _epoch; // (纪元 << 1) | 是否在临界区
+            std::atomic<bool> _in_use;
+            Record* _next;
+
+            // 以下只有持有该 Record 的线程访问
+            std::vector<T*> _retired[3];
+            uint64_t _retired_epoch[3];
+            std::vector<T*> _free;
+            uint32_t _retire_count;
+
+            Record()
+                : _epoch { 0 }
+                , _in_use { true }
+                , _next { nullptr }
+                , _retired_epoch { 0, 0, 0 }
+                , _retire_count { 0 }
+            {}
+        };
+
+        /**
+         * @brief 临界区, 不可嵌套
+         *
+         */
+        class Guard
+        {
+            Record& _record;
+
+            public:
+                Guard(EpochDomain& domain, Record& record)
+                    : _record(record)
+                {
+                    domain.enter(record);
+                }
+
+                ~Guard()
+                {
+                    EpochDomain::exit(_record);
+                }
+
+                Guard(const Guard&) = delete;
+                Guard& operator=(const Guard&) = delete;
+        };
+
+    private:
+        std::atomic<uint64_t> _global;
+        std::atomic<Record*> _records;
+        Destroy _destroy;
+        void* _ctx;
+        uint64_t _id;
+
+        std::mutex _depot_mutex;
+        std::vector<std::vector<T*>> _depot_full;  // 装满 MAGAZINE_SIZE 个节点的弹匣
+        std::vector<std::vector<T*>> _depot_empty; // 已取空的弹匣, 保留容量, 放入时不再分配
+        std::atomic<size_t> _depot_count;          // _depot_full 的大小, 取之前无锁检查
+
+        void enter(Record& record) noexcept
+        {
+            // 公布纪元后的 seq_cst 栅栏保证之后对共享节点的读取不会早于公布
+            record._epoch.store((_global.load(std::memory_order_seq_cst) << 1) | 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+
+        static void exit(Record& record) noexcept
+        {
+            record._epoch.store(record._epoch.load(std::memory_order_relaxed) & ~uint64_t(1), std::memory_order_release);
+        }
+
+        static void release_record(void* record)
+        {
+            static_cast<Record*>(record)->_in_use.store(false, std::memory_order_release);
+        }
+
+        Record* acquire_record()
+        {
+            Record* record = _records.load(std::memory_order_acquire);
+            for (; record; record = record->_next)
+            {
+                bool in_use = false;
+                if (!record->_in_use.load(std::memory_order_relaxed)
+                    && record->_in_use.compare_exchange_strong(in_use, true, std::memory_order_acquire, std::memory_order_relaxed))
+                    return record;
+            }
+
+            record = new Record;
+            Record* head = _records.load(std::memory_order_relaxed);
+            do
+            {
+                record->_next = head;
+            } while (!_records.compare_exchange_weak(head, record, std::memory_order_release, std::memory_order_relaxed));
+
+            return record;
+        }
+
+        void try_advance() noexcept
+        {
+            uint64_t global = _global.load(std::memory_order_seq_cst);
+            for (Record* record = _records.load(std::memory_order_acquire); record; record = record->_next)
+            {
+                uint64_t epoch = record->_epoch.load(std::memory_order_seq_cst);
+                if ((epoch & 1) && (epoch >> 1) != global)
+                    return;
+            }
+            _global.compare_exchange_strong(global, global + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        }
+
+        void collect(Record& record, size_t bucket)
+        {
+            for (T* ptr : record._retired[bucket])
+            {
+                record._free.push_back(ptr);
+                if (record._free.size() >= FREE_LIMIT)
+                    flush(record);
+            }
+            record._retired[bucket].clear();
+        }
+
+        /**
+         * @brief 把空闲列表末尾的 MAGAZINE_SIZE 个节点放入仓库, 仓库已满时销毁
+         *
+         */
+        void flush(Record& record)
+        {
+            const size_t first = record._free.size() - MAGAZINE_SIZE;
+            std::unique_lock<std::mutex> locker(_depot_mutex);
+            if (_depot_full.size() >= DEPOT_LIMIT)
+            {
+                locker.unlock();
+                for (size_t i = first; i < record._free.size(); i++)
+                    _destroy(_ctx, record._free[i]);
+                record._free.resize(first);
+                return;
+            }
+
+            std::vector<T*> magazine;
+            if (!_depot_empty.empty())
+            {
+                magazine = std::move(_depot_empty.back());
+                _depot_empty.pop_back();
+            }
+            magazine.assign(record._free.begin() + static_cast<std::ptrdiff_t>(first), record._free.end());
+            record._free.resize(first);
+            _depot_full.emplace_back(std::move(magazine));
+            _depot_count.store(_depot_full.size(), std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief 空闲列表为空时从仓库取一个弹匣, 空闲列表原有的容量作为空弹匣还给仓库
+         *
+         */
+        bool refill(Record& record)
+        {
+            if (_depot_count.load(std::memory_order_relaxed) == 0)
+                return false;
+
+            std::lock_guard<std::mutex> locker(_depot_mutex);
+            if (_depot_full.empty())
+                return false;
+
+            std::vector<T*> spent;
+            spent.swap(record._free);
+            record._free.swap(_depot_full.back());
+            _depot_full.pop_back();
+            _depot_count.store(_depot_full.size(), std::memory_order_relaxed);
+            if (spent.capacity() >= MAGAZINE_SIZE)
+                _depot_empty.emplace_back(std::move(spent));
+            return true;
+        }
+
+    public:
+        EpochDomain(Destroy destroy, void* ctx)
+            : _global { 0 }
+            , _records { nullptr }
+            , _destroy { destroy }
+            , _ctx { ctx }
+            , _id { detail::register_slot_owner() }
+            , _depot_count { 0 }
+        {}
+
+        /**
+         * @brief 销毁所有退休和空闲的节点, 需要停止所有线程的访问
+         *
+         */
+        ~EpochDomain()
+        {
+            detail::unregister_slot_owner(_id);
+
+            Record* record = _records.load(std::memory_order_relaxed);
+            while (record)
+            {
+                Record* next = record->_next;
+                for (auto& bucket : record->_retired)
+                {
+                    for (T* ptr : bucket)
+                        _destroy(_ctx, ptr);
+                }
+                for (T* ptr : record->_free)
+                    _destroy(_ctx, ptr);
+                delete record;
+                record = next;
+            }
+
+            for (auto& magazine : _depot_full)
+            {
+                for (T* ptr : magazine)
+                    _destroy(_ctx, ptr);
+            }
+        }
+
+        EpochDomain(EpochDomain&&) = delete;
+        EpochDomain(const EpochDomain&) = delete;
+        EpochDomain& operator=(EpochDomain&&) = delete;
+        EpochDomain& operator=(const EpochDomain&) = delete;
+
+        /**
+         * @brief 当前线程的 Record, 首次调用时分配或接管一个空闲的 Record
+         *
+         */
+        Record& local()
+        {
+            detail::ThreadSlotCache& cache = detail::thread_slot_cache();
+            Record* record = static_cast<Record*>(cache.find(_id));
+            if (!record)
+            {
+                record = acquire_record();
+                cache.add(_id, record, &EpochDomain::release_record);
+            }
+
+            return *record;
+        }
+
+        /**
+         * @brief 节点已经从共享结构中摘下, 等到没有线程可能持有时再复用
+         *
+         */
+        void retire(Record& record, T* ptr)
+        {
+            uint64_t global = _global.load(std::memory_order_seq_cst);
+            size_t bucket = static_cast<size_t>(global % 3);
+            if (record._retired_epoch[bucket] != global)
+            {
+                // 该组是三个纪元之前退休的, 已经安全
+                collect(record, bucket);
+                record._retired_epoch[bucket] = global;
+            }
+            record._retired[bucket].push_back(ptr);
+
+            if (++record._retire_count % ADVANCE_INTERVAL == 0)
+                try_advance();
+        }
+
+        /**
+         * @brief 从本线程的空闲列表中取一个可以安全复用的节点, 没有时返回空
+         *
+         */
+        T* reuse(Record& record)
+        {
+            if (record._free.empty())
+            {
+                uint64_t global = _global.load(std::memory_order_seq_cst);
+                for (size_t bucket = 0; bucket < 3; bucket++)
+                {
+                    if (!record._retired[bucket].empty() && record._retired_epoch[bucket] + 2 <= global)
+                        collect(record, bucket);
+                }
+                if (record._free.empty() && !refill(record))
+                    return nullptr;
+            }
+
+            T* ptr = record._free.back();
+            record._free.pop_back();
+            return ptr;
+        }
+};
+
+}
+
+#endif // __JUSTEPOCH_H__
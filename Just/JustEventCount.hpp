@@ -0,0 +1,128 @@
+
+#ifndef __JUSTEVENTCOUNT_H__
+#define __JUSTEVENTCOUNT_H__
+
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+#include "JustConfig.hpp"
+
+
+namespace Just{
+
+/**
+ * @brief 事件计数器, 用于空闲线程的休眠与唤醒
+ *
+ * 使用方式:
+ *     auto key = ec.prepare_wait();
+ *     if (条件已满足) { ec.cancel_wait(); }
+ *     else { ec.commit_wait(key); }
+ *
+ * 通知方在修改条件后调用 notify_one/notify_all, 没有等待者时只有一次原子读,
+ * 不会进入内核.
+ */
+class EventCount final
+{
+    private:
+        // 高 32 位: 纪元, 低 32 位: 等待者数量
+        static constexpr uint64_t WAITER_MASK = 0xFFFFFFFFull;
+        static constexpr uint32_t EPOCH_SHIFT = 32;
+        static constexpr uint64_t EPOCH_ONE = 1ull << EPOCH_SHIFT;
+
+        std::atomic<uint64_t> _state;
+        std::mutex _mutex;
+        std::condition_variable _cond;
+
+        void notify_impl(bool all)
+        {
+            // 与 prepare_wait 中的 RMW 配对, 保证条件修改先于读取等待者数量
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if ((_state.load(std::memory_order_acquire) & WAITER_MASK) == 0)
+                return;
+
+            _state.fetch_add(EPOCH_ONE, std::memory_order_acq_rel);
+            {
+                // 空锁用于与 commit_wait 中的检查串行化, 避免丢失唤醒
+                std::lock_guard<std::mutex> locker(_mutex);
+            }
+
+            if (all)
+                _cond.notify_all();
+            else
+                _cond.notify_one();
+        }
+
+    public:
+        using Key = uint32_t;
+
+        EventCount()
+            : _state { 0 }
+        {}
+
+        EventCount(EventCount&&) = delete;
+        EventCount(const EventCount&) = delete;
+        EventCount& operator=(EventCount&&) = delete;
+        EventCount& operator=(const EventCount&) = delete;
+
+        Key prepare_wait() noexcept
+        {
+            uint64_t prev = _state.fetch_add(1, std::memory_order_seq_cst);
+            return static_cast<Key>(prev >> EPOCH_SHIFT);
+        }
+
+        void cancel_wait() noexcept
+        {
+            _state.fetch_sub(1, std::memory_order_seq_cst);
+        }
+
+        void commit_wait(Key key)
+        {
+            {
+                std::unique_lock<std::mutex> locker(_mutex);
+                _cond.wait(locker, [this, key]() {
+                    return static_cast<Key>(_state.load(std::memory_order_acquire) >> EPOCH_SHIFT) != key;
+                });
+            }
+            _state.fetch_sub(1, std::memory_order_seq_cst);
+        }
+
+        /**
+         * @brief 最多等待 timeout, 超时返回 false
+         *
+         */
+        template<typename Rep, typename Period>
+        bool commit_wait_for(Key key, const std::chrono::duration<Rep, Period>& timeout)
+        {
+            bool notified = false;
+            {
+                std::unique_lock<std::mutex> locker(_mutex);
+                notified = _cond.wait_for(locker, timeout, [this, key]() {
+                    return static_cast<Key>(_state.load(std::memory_order_acquire) >> EPOCH_SHIFT) != key;
+                });
+            }
+            _state.fetch_sub(1, std::memory_order_seq_cst);
+            return notified;
+        }
+
+        void notify_one()
+        {
+            notify_impl(false);
+        }
+
+        void notify_all()
+        {
+            notify_impl(true);
+        }
+
+        uint32_t waiters() const noexcept
+        {
+            return static_cast<uint32_t>(_state.load(std::memory_order_relaxed) & WAITER_MASK);
+        }
+};
+
+}
+
+#endif // __JUSTEVENTCOUNT_H__
@@ -0,0 +1,632 @@
+
+#ifndef __JUSTFUTURE_H__
+#define __JUSTFUTURE_H__
+
+#include <cstddef>
+#include <new>
+#include <tuple>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <future>
+#include <utility>
+#include <exception>
+#include <type_traits>
+#include <condition_variable>
+
+#include "JustTask.hpp"
+#include "JustThreadPool.h"
+
+
+namespace Just{
+
+template<typename T>
+class Future;
+
+template<typename T>
+class Promise;
+
+namespace detail{
+
+struct Unit {};
+
+template<typename T>
+struct FutureValue
+{
+    using type = T;
+};
+
+template<>
+struct FutureValue<void>
+{
+    using type = Unit;
+};
+
+/**
+ * @brief Future 与 Promise 共享的状态
+ *
+ * 完成时在完成者的线程中依次调用回调; 回调只做登记或投递, 不执行用户代码.
+ */
+template<typename T>
+class FutureState
+{
+    public:
+        using Value = typename FutureValue<T>::type;
+
+    private:
+        std::mutex _mutex;
+        std::condition_variable _cond;
+        std::atomic<bool> _ready;
+        bool _has_value;
+        typename std::aligned_storage<sizeof(Value), alignof(Value)>::type _storage;
+        std::exception_ptr _exception;
+        std::vector<Task> _callbacks;
+        ThreadPool* const _pool;
+
+        Value& value() noexcept
+        {
+            return *reinterpret_cast<Value*>(&_storage);
+        }
+
+        template<typename Fill>
+        void complete(Fill&& fill)
+        {
+            std::vector<Task> callbacks;
+            {
+                std::lock_guard<std::mutex> locker(_mutex);
+                if (_ready.load(std::memory_order_relaxed))
+                    throw std::future_error(std::future_errc::promise_already_satisfied);
+                fill();
+                _ready.store(true, std::memory_order_release);
+                callbacks.swap(_callbacks);
+            }
+            _cond.notify_all();
+
+            for (auto& it : callbacks)
+                it();
+        }
+
+    public:
+        explicit FutureState(ThreadPool* pool)
+            : _ready { false }
+            , _has_value { false }
+            , _pool { pool }
+        {}
+
+        ~FutureState()
+        {
+            if (_has_value)
+                value().~Value();
+        }
+
+        FutureState(const FutureState&) = delete;
+        FutureState& operator=(const FutureState&) = delete;
+
+        ThreadPool* pool() const noexcept
+        {
+            return _pool;
+        }
+
+        template<typename... A>
+        void set_value(A&&... args)
+        {
+            complete([&]() {
+                ::new (static_cast<void*>(&_storage)) Value(std::forward<A>(args)...);
+                _has_value = true;
+            });
+        }
+
+        void set_exception(std::exception_ptr e)
+        {
+            complete([&]() { _exception = std::move(e); });
+        }
+
+        /**
+         * @brief 完成后调用 callback, 已经完成时在当前线程立即调用
+         *
+         */
+        void on_ready(Task&& callback)
+        {
+            {
+                std::lock_guard<std::mutex> locker(_mutex);
+                if (!_ready.load(std::memory_order_relaxed)) {
+                    _callbacks.push_back(std::move(callback));
+                    return;
+                }
+            }
+            callback();
+        }
+
+        bool is_ready() const noexcept
+        {
+            return _ready.load(std::memory_order_acquire);
+        }
+
+        void wait()
+        {
+            if (is_ready())
+                return;
+            std::unique_lock<std::mutex> locker(_mutex);
+            _cond.wait(locker, [this]() { return _ready.load(std::memory_order_relaxed); });
+        }
+
+        /**
+         * @brief 等待完成并取出结果, 有异常时重新抛出
+         *
+         */
+        Value take()
+        {
+            wait();
+            if (_exception)
+                std::rethrow_exception(_exception);
+            return std::move(value());
+        }
+};
+
+struct FutureAccess
+{
+    template<typename T>
+    static std::shared_ptr<FutureState<T>>& state(Future<T>& future) noexcept
+    {
+        return future._state;
+    }
+};
+
+// 调用 fn 并把结果写入 state, void 单独处理
+template<typename R, typename Fn>
+void fulfil(FutureState<R>& state, Fn& fn, std::false_type /* void */)
+{
+    state.set_value(fn());
+}
+
+template<typename R, typename Fn>
+void fulfil(FutureState<R>& state, Fn& fn, std::true_type /* void */)
+{
+    fn();
+    state.set_value();
+}
+
+template<typename R, typename Fn>
+void fulfil(FutureState<R>& state, Fn& fn)
+{
+    try {
+        fulfil(state, fn, std::is_void<R>{});
+    }
+    catch (...) {
+        state.set_exception(std::current_exception());
+    }
+}
+
+template<typename F, typename T>
+struct ContinuationResult
+{
+    using type = std::result_of_t<std::decay_t<F>(T&&)>;
+};
+
+template<typename F>
+struct ContinuationResult<F, void>
+{
+    using type = std::result_of_t<std::decay_t<F>()>;
+};
+
+template<typename T>
+struct CallWith
+{
+    template<typename F>
+    static decltype(auto) call(F& fn, FutureState<T>& input)
+    {
+        return fn(input.take());
+    }
+};
+
+template<>
+struct CallWith<void>
+{
+    template<typename F>
+    static decltype(auto) call(F& fn, FutureState<void>& input)
+    {
+        input.take();
+        return fn();
+    }
+};
+
+}
+
+/**
+ * @brief 与线程池关联的 future, 可以用 then 挂接后续任务
+ *
+ * 只可移动; then 与 get 都会消耗结果. 后续任务在输入完成时投递到线程池, 不会阻塞任何线程.
+ */
+template<typename T>
+class Future final
+{
+    private:
+        friend struct detail::FutureAccess;
+        std::shared_ptr<detail::FutureState<T>> _state;
+
+        // 与 std::future 一样, 没有共享状态 (默认构造或已被 get/then 消耗) 时抛出 no_state
+        void require_state() const
+        {
+            if (!_state)
+                throw std::future_error(std::future_errc::no_state);
+        }
+
+    public:
+        Future() noexcept = default;
+
+        explicit Future(std::shared_ptr<detail::FutureState<T>> state) noexcept
+            : _state { std::move(state) }
+        {}
+
+        Future(Future&&) noexcept = default;
+        Future& operator=(Future&&) noexcept = default;
+        Future(const Future&) = delete;
+        Future& operator=(const Future&) = delete;
+
+        bool valid() const noexcept
+        {
+            return _state != nullptr;
+        }
+
+        bool is_ready() const noexcept
+        {
+            return _state && _state->is_ready();
+        }
+
+        /**
+         * @brief 阻塞等待, 不要在线程池的任务中调用, 应使用 then 或 ThreadPool::wait
+         *
+         */
+        void wait() const
+        {
+            require_state();
+            _state->wait();
+        }
+
+        T get()
+        {
+            require_state();
+            std::shared_ptr<detail::FutureState<T>> state = std::move(_state);
+            return static_cast<T>(state->take());
+        }
+
+        /**
+         * @brief 完成后在线程池中以结果调用 func (void 时无参数), 输入的异常直接传给返回的 Future
+         *
+         */
+        template<typename F>
+        Future<typename detail::ContinuationResult<F, T>::type> then(F&& func)
+        {
+            using R = typename detail::ContinuationResult<F, T>::type;
+            require_state();
+            std::shared_ptr<detail::FutureState<T>> input = std::move(_state);
+            ThreadPool* pool = input->pool();
+            Promise<R> promise(pool);
+            Future<R> result = promise.get_future();
+
+            detail::FutureState<T>* source = input.get();
+            source->on_ready([pool, input = std::move(input), promise = std::move(promise), fn = std::decay_t<F>(std::forward<F>(func))]() mutable {
+                auto run = [input = std::move(input), promise = std::move(promise), fn = std::move(fn)]() mutable {
+                    auto call = [&]() -> decltype(auto) { return detail::CallWith<T>::call(fn, *input); };
+                    promise.fulfil(call);
+                };
+                if (pool)
+                    pool->post(std::move(run));
+                else
+                    run();
+            });
+
+            return result;
+        }
+};
+
+/**
+ * @brief 设置 Future 的结果; 未设置就析构时 Future 得到 broken_promise
+ *
+ */
+template<typename T>
+class Promise final
+{
+    private:
+        std::shared_ptr<detail::FutureState<T>> _state;
+        bool _retrieved;
+
+        void abandon()
+        {
+            if (_state && !_state->is_ready())
+                _state->set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+        }
+
+    public:
+        explicit Promise(ThreadPool* pool = nullptr)
+            : _state { std::make_shared<detail::FutureState<T>>(pool) }
+            , _retrieved { false }
+        {}
+
+        Promise(Promise&& other) noexcept
+            : _state { std::move(other._state) }
+            , _retrieved { other._retrieved }
+        {}
+
+        Promise& operator=(Promise&& other)
+        {
+            if (this != &other) {
+                abandon();
+                _state = std::move(other._state);
+                _retrieved = other._retrieved;
+            }
+            return *this;
+        }
+
+        Promise(const Promise&) = delete;
+        Promise& operator=(const Promise&) = delete;
+
+        ~Promise()
+        {
+            abandon();
+        }
+
+        Future<T> get_future()
+        {
+            if (_retrieved)
+                throw std::future_error(std::future_errc::future_already_retrieved);
+            _retrieved = true;
+            return Future<T>(_state);
+        }
+
+        template<typename... A>
+        void set_value(A&&... args)
+        {
+            _state->set_value(std::forward<A>(args)...);
+        }
+
+        void set_exception(std::exception_ptr e)
+        {
+            _state->set_exception(std::move(e));
+        }
+
+        /**
+         * @brief 以 fn() 的返回值或抛出的异常完成
+         *
+         */
+        template<typename Fn>
+        void fulfil(Fn& fn)
+        {
+            detail::fulfil(*_state, fn);
+        }
+};
+
+/**
+ * @brief 在线程池中执行 func(args...), 返回可挂接后续任务的 Future
+ *
+ */
+template<typename Func, typename... Args>
+Future<std::result_of_t<std::decay_t<Func>(std::decay_t<Args>...)>>
+    spawn(ThreadPool& pool, Func&& func, Args&&... args)
+{
+    using ret_t = std::result_of_t<std::decay_t<Func>(std::decay_t<Args>...)>;
+    Promise<ret_t> promise(&pool);
+    Future<ret_t> result = promise.get_future();
+
+    pool.post([promise = std::move(promise), invoker = detail::make_invoker(std::forward<Func>(func), std::forward<Args>(args)...)]() mutable {
+        promise.fulfil(invoker);
+    });
+
+    return result;
+}
+
+template<typename T>
+Future<std::decay_t<T>> make_ready_future(ThreadPool& pool, T&& value)
+{
+    Promise<std::decay_t<T>> promise(&pool);
+    promise.set_value(std::forward<T>(value));
+    return promise.get_future();
+}
+
+inline Future<void> make_ready_future(ThreadPool& pool)
+{
+    Promise<void> promise(&pool);
+    promise.set_value();
+    return promise.get_future();
+}
+
+/**
+ * @brief when_any 的结果: 第一个完成的下标与全部输入
+ *
+ */
+template<typename Sequence>
+struct WhenAnyResult
+{
+    size_t index;
+    Sequence futures;
+};
+
+namespace detail{
+
+// when_all 与 when_any 在接管输入之前检查, 任一输入没有共享状态时抛出 no_state
+inline void require_states() noexcept
+{}
+
+template<typename T, typename... Rest>
+void require_states(const Future<T>& first, const Rest&... rest)
+{
+    if (!first.valid())
+        throw std::future_error(std::future_errc::no_state);
+    require_states(rest...);
+}
+
+template<typename T>
+void require_states(const std::vector<Future<T>>& futures)
+{
+    for (auto& it : futures)
+        require_states(it);
+}
+
+template<typename T>
+ThreadPool* pool_of(Future<T>& future) noexcept
+{
+    auto& state = FutureAccess::state(future);
+    return state ? state->pool() : nullptr;
+}
+
+inline ThreadPool* first_pool() noexcept
+{
+    return nullptr;
+}
+
+template<typename T, typename... Rest>
+ThreadPool* first_pool(Future<T>& first, Rest&... rest) noexcept
+{
+    ThreadPool* pool = pool_of(first);
+    return pool ? pool : first_pool(rest...);
+}
+
+template<typename Sequence>
+struct WhenAllShared
+{
+    Sequence futures;
+    std::atomic<size_t> remain;
+    Promise<Sequence> promise;
+
+    WhenAllShared(Sequence&& seq, size_t count, ThreadPool* pool)
+        : futures { std::move(seq) }
+        , remain { count + 1 } // 多出的 1 在登记完所有回调后释放, 避免登记期间就移走 futures
+        , promise { pool }
+    {}
+
+    void arrive()
+    {
+        if (remain.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            promise.set_value(std::move(futures));
+    }
+};
+
+template<typename Sequence>
+struct WhenAnyShared
+{
+    Sequence futures;
+    std::atomic<size_t> index;
+    std::atomic<int> gate; // 第一个完成者与登记过程都到达后才设置结果
+    Promise<WhenAnyResult<Sequence>> promise;
+
+    WhenAnyShared(Sequence&& seq, ThreadPool* pool)
+        : futures { std::move(seq) }
+        , index { SIZE_MAX }
+        , gate { 2 }
+        , promise { pool }
+    {}
+
+    void pass()
+    {
+        if (gate.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            promise.set_value(WhenAnyResult<Sequence>{ index.load(std::memory_order_relaxed), std::move(futures) });
+    }
+
+    void arrive(size_t i)
+    {
+        size_t expected = SIZE_MAX;
+        if (index.compare_exchange_strong(expected, i, std::memory_order_acq_rel, std::memory_order_relaxed))
+            pass();
+    }
+};
+
+// 对 tuple 中的每个 Future 的状态调用 fn(下标, 状态)
+template<typename Tuple, typename Fn, size_t... I>
+void for_each_state(Tuple& states, Fn& fn, std::index_sequence<I...>)
+{
+    int expand[] = { 0, (fn(I, std::get<I>(states)), 0)... };
+    (void)expand;
+}
+
+}
+
+/**
+ * @brief 所有输入完成后完成, 结果为已就绪的输入; 不阻塞任何线程
+ *
+ * 任一输入没有共享状态时抛出 std::future_error(no_state).
+ */
+template<typename T>
+Future<std::vector<Future<T>>> when_all(std::vector<Future<T>> futures)
+{
+    using Sequence = std::vector<Future<T>>;
+    detail::require_states(futures);
+    ThreadPool* pool = futures.empty() ? nullptr : detail::pool_of(futures.front());
+    std::vector<std::shared_ptr<detail::FutureState<T>>> states;
+    for (auto& it : futures)
+        states.push_back(detail::FutureAccess::state(it));
+
+    auto shared = std::make_shared<detail::WhenAllShared<Sequence>>(std::move(futures), states.size(), pool);
+    Future<Sequence> result = shared->promise.get_future();
+    for (auto& it : states)
+        it->on_ready([shared]() { shared->arrive(); });
+    shared->arrive();
+
+    return result;
+}
+
+template<typename... Ts>
+Future<std::tuple<Future<Ts>...>> when_all(Future<Ts>&&... futures)
+{
+    using Sequence = std::tuple<Future<Ts>...>;
+    detail::require_states(futures...);
+    ThreadPool* pool = detail::first_pool(futures...);
+    auto states = std::make_tuple(detail::FutureAccess::state(futures)...);
+
+    auto shared = std::make_shared<detail::WhenAllShared<Sequence>>(Sequence(std::move(futures)...), sizeof...(Ts), pool);
+    Future<Sequence> result = shared->promise.get_future();
+    auto subscribe = [&shared](size_t, auto& state) { state->on_ready([shared]() { shared->arrive(); }); };
+    detail::for_each_state(states, subscribe, std::index_sequence_for<Ts...>{});
+    shared->arrive();
+
+    return result;
+}
+
+/**
+ * @brief 任一输入完成后完成, 结果中的 index 为第一个完成的下标; 输入为空时 index 为 SIZE_MAX
+ *
+ * 任一输入没有共享状态时抛出 std::future_error(no_state).
+ */
+template<typename T>
+Future<WhenAnyResult<std::vector<Future<T>>>> when_any(std::vector<Future<T>> futures)
+{
+    using Sequence = std::vector<Future<T>>;
+    detail::require_states(futures);
+    ThreadPool* pool = futures.empty() ? nullptr : detail::pool_of(futures.front());
+    std::vector<std::shared_ptr<detail::FutureState<T>>> states;
+    for (auto& it : futures)
+        states.push_back(detail::FutureAccess::state(it));
+
+    auto shared = std::make_shared<detail::WhenAnyShared<Sequence>>(std::move(futures), pool);
+    Future<WhenAnyResult<Sequence>> result = shared->promise.get_future();
+    for (size_t i = 0; i < states.size(); i++)
+        states[i]->on_ready([shared, i]() { shared->arrive(i); });
+    if (states.empty())
+        shared->pass();
+    shared->pass();
+
+    return result;
+}
+
+template<typename... Ts>
+Future<WhenAnyResult<std::tuple<Future<Ts>...>>> when_any(Future<Ts>&&... futures)
+{
+    using Sequence = std::tuple<Future<Ts>...>;
+    detail::require_states(futures...);
+    ThreadPool* pool = detail::first_pool(futures...);
+    auto states = std::make_tuple(detail::FutureAccess::state(futures)...);
+
+    auto shared = std::make_shared<detail::WhenAnyShared<Sequence>>(Sequence(std::move(futures)...), pool);
+    Future<WhenAnyResult<Sequence>> result = shared->promise.get_future();
+    auto subscribe = [&shared](size_t i, auto& state) { state->on_ready([shared, i]() { shared->arrive(i); }); };
+    detail::for_each_state(states, subscribe, std::index_sequence_for<Ts...>{});
+    if (sizeof...(Ts) == 0)
+        shared->pass();
+    shared->pass();
+
+    return result;
+}
+
+}
+
+#endif // __JUSTFUTURE_H__
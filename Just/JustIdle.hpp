@@ -0,0 +1,339 @@
+
+#ifndef __JUSTIDLE_H__
+#define __JUSTIDLE_H__
+
+#include <cstddef>
+#include <chrono>
+#include <thread>
+#include <utility>
+
+#include "JustConfig.hpp"
+#include "JustEventCount.hpp"
+
+
+namespace Just{
+
+// 指数退避中一轮自旋的暂停次数上限为 2^BACKOFF_SHIFT_MAX
+constexpr const size_t BACKOFF_SHIFT_MAX = 10;
+
+/**
+ * @brief 连续执行 count 次 cpu_relax
+ *
+ */
+inline void spin_pause(size_t count) noexcept
+{
+    for (size_t i = 0; i < count; i++)
+        cpu_relax();
+}
+
+/**
+ * @brief 指数退避第 step 轮的暂停次数, 1, 2, 4 ... 2^BACKOFF_SHIFT_MAX
+ *
+ */
+inline size_t backoff_pauses(size_t step) noexcept
+{
+    return size_t(1) << (step < BACKOFF_SHIFT_MAX ? step : BACKOFF_SHIFT_MAX);
+}
+
+/**
+ * @brief 指数退避第 step 次 sleep 的时长, 从 min 开始加倍, 不超过 max
+ *
+ */
+inline std::chrono::microseconds backoff_sleep(size_t step, std::chrono::microseconds min, std::chrono::microseconds max) noexcept
+{
+    if (step >= 30)
+        return max;
+    std::chrono::microseconds wait = min * (int64_t(1) << step);
+    return wait < max ? wait : max;
+}
+
+/**
+ * @brief DynamicIdle 与 ThreadPool::Options 选择的等待方式
+ *
+ */
+enum class IdleStrategy
+{
+    SpinPark,  // 自旋, 让出, 然后休眠等待入队唤醒 (默认)
+    BusySpin,  // 一直自旋, 唤醒延迟最低, 空闲的线程占满一个核
+    Backoff,   // 每轮自旋的暂停次数加倍, 之后 sleep 的时长加倍, 不需要入队唤醒
+    Block,     // 取不到任务立即休眠
+};
+
+/**
+ * @brief 空闲策略: 先自旋, 再让出, 最后在 EventCount 上休眠, 入队时唤醒
+ *
+ * 空闲策略的接口:
+ *     void idle(size_t& round, Ready&& ready);     // 取任务失败后调用, round 为连续失败次数, ready() 为 true 时不可休眠
+ *     bool idle_for(size_t& round, Ready&& ready, timeout); // 同 idle, 休眠最多 timeout, 超时返回 false
+ *     bool parks(size_t round) const;              // 本轮 idle 是否会休眠或 sleep, 用于统计
+ *     void notify_one();                           // 入队之后调用
+ *     void notify_all();                           // 停止时调用
+ * 模板参数为阈值的默认值, 也可以在构造时指定.
+ */
+template<size_t SpinCount = 64, size_t YieldCount = 16>
+class SpinYieldPark final
+{
+    private:
+        EventCount _event;
+        size_t _spin_count;   // 休眠前的自旋次数
+        size_t _yield_count;  // 自旋之后的让出次数
+
+        void spin_or_yield(size_t& round)
+        {
+            if (round < _spin_count)
+                cpu_relax();
+            else
+                std::this_thread::yield();
+            ++round;
+        }
+
+    public:
+        explicit SpinYieldPark(size_t spin_count = SpinCount, size_t yield_count = YieldCount) noexcept
+            : _spin_count { spin_count }
+            , _yield_count { yield_count }
+        {}
+
+        bool parks(size_t round) const noexcept
+        {
+            return round >= _spin_count + _yield_count;
+        }
+
+        template<typename Ready>
+        void idle(size_t& round, Ready&& ready)
+        {
+            if (!parks(round))
+            {
+                spin_or_yield(round);
+                return;
+            }
+
+            // 先登记为等待者再检查条件, 与 notify 配合避免丢失唤醒
+            EventCount::Key key = _event.prepare_wait();
+            if (ready())
+                _event.cancel_wait();
+            else
+                _event.commit_wait(key);
+            round = 0;
+        }
+
+        /**
+         * @brief 超时后 round 不清零, 下一次直接休眠
+         *
+         */
+        template<typename Ready, typename Rep, typename Period>
+        bool idle_for(size_t& round, Ready&& ready, const std::chrono::duration<Rep, Period>& timeout)
+        {
+            if (!parks(round))
+            {
+                spin_or_yield(round);
+                return true;
+            }
+
+            EventCount::Key key = _event.prepare_wait();
+            if (ready())
+            {
+                _event.cancel_wait();
+            }
+            else if (!_event.commit_wait_for(key, timeout))
+            {
+                return false;
+            }
+            round = 0;
+            return true;
+        }
+
+        void notify_one()
+        {
+            _event.notify_one();
+        }
+
+        void notify_all()
+        {
+            _event.notify_all();
+        }
+};
+
+using SpinPark = SpinYieldPark<>;
+
+/**
+ * @brief 空闲策略: 取不到任务立即休眠, 空闲时不占用 CPU, 唤醒需要一次系统调用
+ *
+ */
+using Blocking = SpinYieldPark<0, 0>;
+
+/**
+ * @brief 空闲策略: 一直自旋, 唤醒延迟最低, 空闲的线程占满一个核
+ *
+ */
+class BusySpin final
+{
+    public:
+        bool parks(size_t) const noexcept
+        {
+            return false;
+        }
+
+        template<typename Ready>
+        void idle(size_t& round, Ready&&)
+        {
+            ++round;
+            cpu_relax();
+        }
+
+        template<typename Ready, typename Rep, typename Period>
+        bool idle_for(size_t& round, Ready&& ready, const std::chrono::duration<Rep, Period>&)
+        {
+            idle(round, std::forward<Ready>(ready));
+            return true;
+        }
+
+        void notify_one() noexcept {}
+        void notify_all() noexcept {}
+};
+
+/**
+ * @brief 空闲策略: 每轮自旋的暂停次数加倍, SpinCount 轮后 sleep, 时长从 MinSleepUs 加倍到 MaxSleepUs
+ *
+ * 不休眠在 EventCount 上, 入队时不需要通知; 唤醒延迟不超过 MaxSleepUs. idle_for 不会超时.
+ */
+template<size_t SpinCount = 10, size_t MinSleepUs = 1, size_t MaxSleepUs = 1000>
+class ExponentialBackoff final
+{
+    private:
+        size_t _spin_count;
+        std::chrono::microseconds _min_sleep;
+        std::chrono::microseconds _max_sleep;
+
+    public:
+        explicit ExponentialBackoff(size_t spin_count = SpinCount,
+                                    std::chrono::microseconds min_sleep = std::chrono::microseconds(MinSleepUs),
+                                    std::chrono::microseconds max_sleep = std::chrono::microseconds(MaxSleepUs)) noexcept
+            : _spin_count { spin_count }
+            , _min_sleep { min_sleep.count() > 0 ? min_sleep : std::chrono::microseconds(1) }
+            , _max_sleep { max_sleep > _min_sleep ? max_sleep : _min_sleep }
+        {}
+
+        bool parks(size_t round) const noexcept
+        {
+            return round >= _spin_count;
+        }
+
+        template<typename Ready>
+        void idle(size_t& round, Ready&& ready)
+        {
+            idle_for(round, std::forward<Ready>(ready), _max_sleep);
+        }
+
+        template<typename Ready, typename Rep, typename Period>
+        bool idle_for(size_t& round, Ready&& ready, const std::chrono::duration<Rep, Period>& timeout)
+        {
+            if (round < _spin_count)
+            {
+                spin_pause(backoff_pauses(round));
+                ++round;
+                return true;
+            }
+
+            if (!ready())
+            {
+                std::chrono::microseconds wait = backoff_sleep(round - _spin_count, _min_sleep, _max_sleep);
+                std::chrono::microseconds limit = std::chrono::duration_cast<std::chrono::microseconds>(timeout);
+                std::this_thread::sleep_for(wait < limit ? wait : limit);
+            }
+            ++round;
+            return true;
+        }
+
+        void notify_one() noexcept {}
+        void notify_all() noexcept {}
+};
+
+/**
+ * @brief 空闲策略: 构造时按 IdleStrategy 选择以上的一种并指定阈值, ThreadPool 的线程使用
+ *
+ * 每次调用多一次分支; 编译期确定策略时直接使用对应的类.
+ * BusySpin 与 Backoff 下 idle_for 不会超时.
+ */
+class DynamicIdle final
+{
+    private:
+        IdleStrategy _strategy;
+        SpinYieldPark<> _park;        // SpinPark 与 Block
+        ExponentialBackoff<> _backoff;
+        BusySpin _spin;
+
+    public:
+        explicit DynamicIdle(IdleStrategy strategy = IdleStrategy::SpinPark,
+                             size_t spin_count = 64,
+                             size_t yield_count = 16,
+                             std::chrono::microseconds backoff_min = std::chrono::microseconds(1),
+                             std::chrono::microseconds backoff_max = std::chrono::microseconds(1000)) noexcept
+            : _strategy { strategy }
+            , _park { strategy == IdleStrategy::Block ? 0 : spin_count, strategy == IdleStrategy::SpinPark ? yield_count : 0 }
+            , _backoff { spin_count, backoff_min, backoff_max }
+        {}
+
+        IdleStrategy strategy() const noexcept
+        {
+            return _strategy;
+        }
+
+        bool parks(size_t round) const noexcept
+        {
+            switch (_strategy)
+            {
+            case IdleStrategy::BusySpin:
+                return _spin.parks(round);
+            case IdleStrategy::Backoff:
+                return _backoff.parks(round);
+            default:
+                return _park.parks(round);
+            }
+        }
+
+        template<typename Ready>
+        void idle(size_t& round, Ready&& ready)
+        {
+            switch (_strategy)
+            {
+            case IdleStrategy::BusySpin:
+                _spin.idle(round, std::forward<Ready>(ready));
+                break;
+            case IdleStrategy::Backoff:
+                _backoff.idle(round, std::forward<Ready>(ready));
+                break;
+            default:
+                _park.idle(round, std::forward<Ready>(ready));
+                break;
+            }
+        }
+
+        template<typename Ready, typename Rep, typename Period>
+        bool idle_for(size_t& round, Ready&& ready, const std::chrono::duration<Rep, Period>& timeout)
+        {
+            switch (_strategy)
+            {
+            case IdleStrategy::BusySpin:
+                return _spin.idle_for(round, std::forward<Ready>(ready), timeout);
+            case IdleStrategy::Backoff:
+                return _backoff.idle_for(round, std::forward<Ready>(ready), timeout);
+            default:
+                return _park.idle_for(round, std::forward<Ready>(ready), timeout);
+            }
+        }
+
+        // 其他策略下没有线程在 EventCount 上等待, 通知只是一次原子读
+        void notify_one()
+        {
+            _park.notify_one();
+        }
+
+        void notify_all()
+        {
+            _park.notify_all();
+        }
+};
+
+}
+
+#endif // __JUSTIDLE_H__
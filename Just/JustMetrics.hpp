@@ -0,0 +1,161 @@
+
+#ifndef __JUSTMETRICS_H__
+#define __JUSTMETRICS_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+namespace Just{
+
+/**
+ * @brief 按 2 的幂分桶的耗时直方图, 单位为纳秒
+ *
+ * buckets[0] 为 0ns, buckets[i] 为 [2^(i-1), 2^i) ns, 最后一个桶不设上限.
+ */
+struct LatencyHistogram
+{
+    static constexpr const size_t BUCKETS = 40;
+
+    uint64_t buckets[BUCKETS];
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+
+    LatencyHistogram() noexcept
+        : buckets {}
+        , count { 0 }
+        , total_ns { 0 }
+        , max_ns { 0 }
+    {}
+
+    static size_t bucket_of(uint64_t ns) noexcept
+    {
+        size_t index = 0;
+        while (ns && index + 1 < BUCKETS)
+        {
+            ns >>= 1;
+            ++index;
+        }
+        return index;
+    }
+
+    /**
+     * @brief 第 index 个桶的上界 (不含)
+     *
+     */
+    static uint64_t upper_bound(size_t index) noexcept
+    {
+        return index + 1 < BUCKETS ? (uint64_t(1) << index) : UINT64_MAX;
+    }
+
+    double mean_ns() const noexcept
+    {
+        return count ? static_cast<double>(total_ns) / static_cast<double>(count) : 0.0;
+    }
+
+    /**
+     * @brief 第 p (0 ~ 1) 分位所在桶的上界, 不超过观测到的最大值
+     *
+     */
+    uint64_t percentile(double p) const noexcept
+    {
+        if (count == 0)
+            return 0;
+
+        uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(count));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; i++)
+        {
+            seen += buckets[i];
+            if (seen > rank || seen == count)
+                return upper_bound(i) < max_ns ? upper_bound(i) : max_ns;
+        }
+        return max_ns;
+    }
+
+    void merge(const LatencyHistogram& other) noexcept
+    {
+        for (size_t i = 0; i < BUCKETS; i++)
+            buckets[i] += other.buckets[i];
+        count += other.count;
+        total_ns += other.total_ns;
+        if (other.max_ns > max_ns)
+            max_ns = other.max_ns;
+    }
+};
+
+/**
+ * @brief 一个工作者的累计统计, 时间统计到该线程最近一次状态切换或采样
+ *
+ */
+struct WorkerMetrics
+{
+    uint64_t tasks;          // 执行的任务数
+    uint64_t busy_ns;        // 执行任务的时间
+    uint64_t idle_ns;        // 自旋与让出的时间
+    uint64_t parked_ns;      // 休眠的时间
+    uint64_t failed_pops;    // 没有取到任务的次数
+    uint64_t steals;         // 窃取成功的次数
+    uint64_t failed_steals;  // 遍历所有窃取对象都没有取到的次数
+    bool running;            // 当前是否有线程在使用该工作者
+
+    WorkerMetrics() noexcept
+        : tasks { 0 }
+        , busy_ns { 0 }
+        , idle_ns { 0 }
+        , parked_ns { 0 }
+        , failed_pops { 0 }
+        , steals { 0 }
+        , failed_steals { 0 }
+        , running { false }
+    {}
+
+    /**
+     * @brief 忙碌时间占总时间的比例
+     *
+     */
+    double utilization() const noexcept
+    {
+        uint64_t total = busy_ns + idle_ns + parked_ns;
+        return total ? static_cast<double>(busy_ns) / static_cast<double>(total) : 0.0;
+    }
+
+    void merge(const WorkerMetrics& other) noexcept
+    {
+        tasks += other.tasks;
+        busy_ns += other.busy_ns;
+        idle_ns += other.idle_ns;
+        parked_ns += other.parked_ns;
+        failed_pops += other.failed_pops;
+        steals += other.steals;
+        failed_steals += other.failed_steals;
+    }
+};
+
+/**
+ * @brief ThreadPool::metrics() 返回的快照
+ *
+ * 计数是精确的; 两个直方图只包含采样的任务, 每个提交线程每 sample_interval 个任务采样一个.
+ */
+struct PoolMetrics
+{
+    WorkerMetrics total;                // 所有工作者之和, 包括 stop 之前退出的线程
+    std::vector<WorkerMetrics> workers; // 当前的每个工作者, 包括未运行的
+    LatencyHistogram queue_wait;        // 从提交到开始执行
+    LatencyHistogram execution;         // 执行耗时
+    size_t sample_interval;
+    size_t threads;                     // 正在运行的线程数
+    size_t queued;                      // 排队中的任务数
+
+    PoolMetrics() noexcept
+        : sample_interval { 0 }
+        , threads { 0 }
+        , queued { 0 }
+    {}
+};
+
+}
+
+#endif // __JUSTMETRICS_H__
@@ -0,0 +1,352 @@
+
+#ifndef __JUSTPARALLEL_H__
+#define __JUSTPARALLEL_H__
+
+#include <cstddef>
+#include <new>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <exception>
+#include <type_traits>
+#include <condition_variable>
+
+#include "JustConfig.hpp"
+#include "JustThreadPool.h"
+
+
+namespace Just{
+
+namespace detail{
+
+struct NoPartial {};
+
+/**
+ * @brief 递归二分的并行循环
+ *
+ * 执行者每次把区间的右半部分放入 pieces 并投递到线程池, 自己继续处理左半部分, 直到
+ * 区间不大于 grain. 空闲线程取走右半部分后继续二分, 负载不均时自然由空闲线程分担.
+ * 调用线程同样参与: 处理完自己的区间后按后进先出认领尚未被取走的部分, 因此即使在
+ * 线程池的线程中调用也不会死锁. pieces 在开始时一次性分配, 循环体的每次迭代没有分配.
+ */
+template<typename Body, typename Partial>
+class ParallelLoop final : public std::enable_shared_from_this<ParallelLoop<Body, Partial>>
+{
+    private:
+        struct Piece
+        {
+            size_t lo;
+            size_t hi;
+            std::atomic<bool> ready;     // lo, hi 与 partial 已经写好
+            std::atomic<bool> claimed;
+            typename std::aligned_storage<sizeof(Partial), alignof(Partial)>::type storage;
+
+            Partial& partial() noexcept
+            {
+                return *reinterpret_cast<Partial*>(&storage);
+            }
+        };
+
+        ThreadPool& _pool;
+        Body& _body;
+        const Partial& _identity;
+        const size_t _grain;
+        const size_t _capacity;
+        std::unique_ptr<Piece[]> _pieces;
+        std::atomic<size_t> _count;      // 已经分配出去的 piece 下标
+        std::atomic<size_t> _pending;    // 已经创建但尚未完成的 piece 数
+        std::atomic<size_t> _published;  // 创建 piece 的次数, 唤醒等待中的调用线程
+        std::atomic<bool> _waiting;
+        std::atomic<bool> _failed;
+        std::exception_ptr _exception;
+        std::mutex _mutex;
+        std::condition_variable _cond;
+
+        void fail()
+        {
+            std::lock_guard<std::mutex> locker(_mutex);
+            if (!_exception)
+                _exception = std::current_exception();
+            _failed.store(true, std::memory_order_relaxed);
+        }
+
+        void wake()
+        {
+            std::lock_guard<std::mutex> locker(_mutex);
+            _cond.notify_all();
+        }
+
+        void execute(size_t lo, size_t hi, Partial& partial)
+        {
+            while (hi - lo > _grain && !_failed.load(std::memory_order_relaxed))
+            {
+                size_t index = _count.fetch_add(1, std::memory_order_relaxed);
+                if (index >= _capacity)
+                    break; // piece 用完, 剩余部分直接在本线程执行
+
+                size_t mid = lo + (hi - lo) / 2;
+                Piece& piece = _pieces[index];
+                piece.lo = mid;
+                piece.hi = hi;
+                ::new (static_cast<void*>(&piece.storage)) Partial(_identity);
+                _pending.fetch_add(1, std::memory_order_relaxed);
+                piece.ready.store(true, std::memory_order_release);
+
+                auto self = this->shared_from_this();
+                _pool.post([self, index]() { self->run_piece(index); });
+
+                _published.fetch_add(1, std::memory_order_seq_cst);
+                if (_waiting.load(std::memory_order_seq_cst))
+                    wake();
+                hi = mid;
+            }
+
+            if (_failed.load(std::memory_order_relaxed))
+                return;
+
+            try {
+                _body(lo, hi, partial);
+            }
+            catch (...) {
+                fail();
+            }
+        }
+
+        bool claim(size_t index) noexcept
+        {
+            Piece& piece = _pieces[index];
+            return piece.ready.load(std::memory_order_acquire)
+                && !piece.claimed.load(std::memory_order_relaxed)
+                && !piece.claimed.exchange(true, std::memory_order_acq_rel);
+        }
+
+        void finish()
+        {
+            if (_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                wake();
+        }
+
+        void run_piece(size_t index)
+        {
+            // 调用线程可能已经认领过, 此时什么也不做
+            if (!claim(index))
+                return;
+            Piece& piece = _pieces[index];
+            execute(piece.lo, piece.hi, piece.partial());
+            finish();
+        }
+
+        bool help()
+        {
+            bool found = false;
+            size_t count = std::min(_count.load(std::memory_order_relaxed), _capacity);
+            for (size_t i = count; i-- > 0; )
+            {
+                if (claim(i)) {
+                    Piece& piece = _pieces[i];
+                    execute(piece.lo, piece.hi, piece.partial());
+                    finish();
+                    found = true;
+                }
+            }
+            return found;
+        }
+
+    public:
+        ParallelLoop(ThreadPool& pool, Body& body, const Partial& identity, size_t grain, size_t capacity)
+            : _pool(pool)
+            , _body(body)
+            , _identity(identity)
+            , _grain { grain ? grain : 1 }
+            , _capacity { capacity }
+            , _pieces { new Piece[capacity] }
+            , _count { 0 }
+            , _pending { 0 }
+            , _published { 0 }
+            , _waiting { false }
+            , _failed { false }
+        {
+            for (size_t i = 0; i < capacity; i++)
+            {
+                _pieces[i].ready.store(false, std::memory_order_relaxed);
+                _pieces[i].claimed.store(false, std::memory_order_relaxed);
+            }
+        }
+
+        ~ParallelLoop()
+        {
+            for (size_t i = 0; i < _capacity; i++)
+            {
+                if (_pieces[i].ready.load(std::memory_order_relaxed))
+                    _pieces[i].partial().~Partial();
+            }
+        }
+
+        /**
+         * @brief 在调用线程中执行 [0, n), 返回后所有 piece 都已完成; 有异常时重新抛出
+         *
+         */
+        void run(size_t n, Partial& root)
+        {
+            execute(0, n, root);
+
+            for (;;)
+            {
+                if (help())
+                    continue;
+
+                _waiting.store(true, std::memory_order_seq_cst);
+                size_t seen = _published.load(std::memory_order_seq_cst);
+                if (help())
+                    continue;
+
+                std::unique_lock<std::mutex> locker(_mutex);
+                _cond.wait(locker, [&]() {
+                    return _pending.load(std::memory_order_acquire) == 0
+                        || _published.load(std::memory_order_seq_cst) != seen;
+                });
+                if (_pending.load(std::memory_order_acquire) == 0)
+                    break;
+            }
+
+            if (_exception)
+                std::rethrow_exception(_exception);
+        }
+
+        /**
+         * @brief 按区间顺序合并各部分的结果, 只要求 reduce 满足结合律
+         *
+         */
+        template<typename Reduce>
+        Partial combine(Partial&& root, Reduce& reduce)
+        {
+            std::vector<Piece*> done;
+            size_t count = std::min(_count.load(std::memory_order_relaxed), _capacity);
+            for (size_t i = 0; i < count; i++)
+            {
+                if (_pieces[i].ready.load(std::memory_order_relaxed))
+                    done.push_back(&_pieces[i]);
+            }
+            std::sort(done.begin(), done.end(), [](Piece* a, Piece* b) { return a->lo < b->lo; });
+
+            Partial result = std::move(root);
+            for (Piece* it : done)
+                result = reduce(std::move(result), std::move(it->partial()));
+            return result;
+        }
+};
+
+inline size_t parallel_grain(ThreadPool& pool, size_t n, size_t grain)
+{
+    // 未指定时每个线程大约分到 8 份
+    if (grain)
+        return grain;
+    size_t threads = std::max<size_t>(pool.thread_count(), 1);
+    return std::max<size_t>(n / (threads * 8), 1);
+}
+
+inline size_t parallel_capacity(ThreadPool& pool, size_t n, size_t grain)
+{
+    size_t leaves = 2 * (n / grain) + 2;
+    size_t limit = std::max<size_t>(pool.thread_count(), 1) * 64;
+    return std::min(leaves, limit);
+}
+
+template<typename Index, typename Body, typename Partial>
+void parallel_run(ThreadPool& pool, Index n, size_t grain, Body& body, const Partial& identity, Partial& root)
+{
+    using Loop = ParallelLoop<Body, Partial>;
+    const size_t count = static_cast<size_t>(n);
+    grain = parallel_grain(pool, count, grain);
+    if (count <= grain) {
+        body(0, count, root);
+        return;
+    }
+
+    auto loop = std::make_shared<Loop>(pool, body, identity, grain, parallel_capacity(pool, count, grain));
+    loop->run(count, root);
+}
+
+}
+
+/**
+ * @brief 对 [first, last) 中的每个下标调用 func(i), 调用线程参与执行并在全部完成后返回
+ *
+ * grain 为不再拆分的区间长度, 0 表示按线程数自动选择. 循环体抛出的第一个异常在这里重新抛出.
+ */
+template<typename Index, typename Func>
+void parallel_for(ThreadPool& pool, Index first, Index last, size_t grain, Func&& func)
+{
+    static_assert(std::is_integral<Index>::value, "parallel_for requires an integral index");
+    if (!(first < last))
+        return;
+
+    auto body = [&func, first](size_t lo, size_t hi, detail::NoPartial&) {
+        for (size_t i = lo; i < hi; i++)
+            func(static_cast<Index>(first + static_cast<Index>(i)));
+    };
+    detail::NoPartial none;
+    detail::parallel_run(pool, last - first, grain, body, none, none);
+}
+
+/**
+ * @brief 计算 reduce(... reduce(identity, map(first)) ..., map(last - 1))
+ *
+ * 各部分按区间顺序合并, reduce 只需满足结合律, identity 为单位元.
+ */
+template<typename Index, typename T, typename Map, typename Reduce>
+T parallel_reduce(ThreadPool& pool, Index first, Index last, size_t grain, T identity, Map&& map, Reduce&& reduce)
+{
+    static_assert(std::is_integral<Index>::value, "parallel_reduce requires an integral index");
+    if (!(first < last))
+        return identity;
+
+    auto body = [&map, &reduce, first](size_t lo, size_t hi, T& partial) {
+        for (size_t i = lo; i < hi; i++)
+            partial = reduce(std::move(partial), map(static_cast<Index>(first + static_cast<Index>(i))));
+    };
+
+    using Body = decltype(body);
+    const size_t count = static_cast<size_t>(last - first);
+    grain = detail::parallel_grain(pool, count, grain);
+    T root = identity;
+    if (count <= grain) {
+        body(0, count, root);
+        return root;
+    }
+
+    auto loop = std::make_shared<detail::ParallelLoop<Body, T>>(pool, body, identity, grain, detail::parallel_capacity(pool, count, grain));
+    loop->run(count, root);
+    return loop->combine(std::move(root), reduce);
+}
+
+/**
+ * @brief out[i] = op(first[i]), 输入与输出都需要是随机访问迭代器
+ *
+ */
+template<typename InIt, typename OutIt, typename Op>
+OutIt parallel_transform(ThreadPool& pool, InIt first, InIt last, OutIt out, size_t grain, Op&& op)
+{
+    const auto n = std::distance(first, last);
+    if (n <= 0)
+        return out;
+
+    auto body = [&op, first, out](size_t lo, size_t hi, detail::NoPartial&) {
+        InIt in = first + static_cast<typename std::iterator_traits<InIt>::difference_type>(lo);
+        OutIt dst = out + static_cast<typename std::iterator_traits<OutIt>::difference_type>(lo);
+        for (size_t i = lo; i < hi; i++, ++in, ++dst)
+            *dst = op(*in);
+    };
+    detail::NoPartial none;
+    detail::parallel_run(pool, static_cast<size_t>(n), grain, body, none, none);
+
+    return out + n;
+}
+
+}
+
+#endif // __JUSTPARALLEL_H__
@@ -0,0 +1,220 @@
+
+#ifndef __JUSTSPSCQUEUE_H__
+#define __JUSTSPSCQUEUE_H__
+
+#include <cstddef>
+#include <new>
+#include <atomic>
+#include <utility>
+#include <iterator>
+#include <type_traits>
+
+#include "JustConfig.hpp"
+
+
+namespace Just{
+
+/**
+ * @brief 有界单生产者单消费者环形队列, 无等待
+ *
+ * 生产者与消费者各自缓存对方的下标, 只有缓存判断为满/空时才读取对方的缓存行.
+ * 只使用 acquire/release 的读写, 没有 RMW 操作.
+ */
+template<typename T>
+class SpscQueue final
+{
+    private:
+        using Storage = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+        Storage* const _slots;
+        const size_t _mask;
+        char _pad0[CACHE_LINE_SIZE - sizeof(Storage*) - sizeof(size_t)];
+
+        // 生产者缓存行
+        std::atomic<size_t> _tail;
+        size_t _head_cache;
+        char _pad1[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+
+        // 消费者缓存行
+        std::atomic<size_t> _head;
+        size_t _tail_cache;
+        char _pad2[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+
+        static size_t round_capacity(size_t capacity) noexcept
+        {
+            size_t cap = 2;
+            while (cap < capacity)
+                cap <<= 1;
+            return cap;
+        }
+
+        T* item(size_t index) noexcept
+        {
+            return reinterpret_cast<T*>(_slots + (index & _mask));
+        }
+
+        // 可写入的槽位数, 不足 want 时才刷新消费者下标
+        size_t writable(size_t tail, size_t want) noexcept
+        {
+            size_t free = capacity() - (tail - _head_cache);
+            if (free < want) {
+                _head_cache = _head.load(std::memory_order_acquire);
+                free = capacity() - (tail - _head_cache);
+            }
+            return free;
+        }
+
+        // 可读取的元素数, 不足 want 时才刷新生产者下标
+        size_t readable(size_t head, size_t want) noexcept
+        {
+            size_t avail = _tail_cache - head;
+            if (avail < want) {
+                _tail_cache = _tail.load(std::memory_order_acquire);
+                avail = _tail_cache - head;
+            }
+            return avail;
+        }
+
+        template<typename U>
+        bool emplace(U&& v)
+        {
+            size_t tail = _tail.load(std::memory_order_relaxed);
+            if (writable(tail, 1) == 0)
+                return false;
+
+            ::new (static_cast<void*>(item(tail))) T(std::forward<U>(v));
+            _tail.store(tail + 1, std::memory_order_release);
+
+            return true;
+        }
+
+    public:
+        explicit SpscQueue(size_t capacity)
+            : _slots { new Storage[round_capacity(capacity)] }
+            , _mask { round_capacity(capacity) - 1 }
+            , _tail { 0 }
+            , _head_cache { 0 }
+            , _head { 0 }
+            , _tail_cache { 0 }
+        {}
+
+        /**
+         * @brief 析构剩余元素, 需要停止 push pop
+         *
+         */
+        ~SpscQueue()
+        {
+            size_t head = _head.load(std::memory_order_relaxed);
+            size_t tail = _tail.load(std::memory_order_relaxed);
+            for (; head != tail; ++head)
+                item(head)->~T();
+            delete[] _slots;
+        }
+
+        SpscQueue(SpscQueue&&) = delete;
+        SpscQueue(const SpscQueue&) = delete;
+        SpscQueue& operator=(SpscQueue&&) = delete;
+        SpscQueue& operator=(const SpscQueue&) = delete;
+
+        /**
+         * @brief 仅生产者线程调用
+         *
+         */
+        bool try_push(const T& v)
+        {
+            return emplace(v);
+        }
+
+        bool try_push(T&& v)
+        {
+            return emplace(std::move(v));
+        }
+
+        /**
+         * @brief 仅生产者线程调用, 写入尽可能多的元素后一次性发布
+         *
+         * @return size_t 写入的元素个数
+         */
+        template<typename It>
+        size_t push_bulk(It first, It last)
+        {
+            size_t tail = _tail.load(std::memory_order_relaxed);
+            size_t want = static_cast<size_t>(std::distance(first, last));
+            size_t count = writable(tail, want);
+            if (count > want)
+                count = want;
+
+            for (size_t i = 0; i < count; ++i, ++first)
+                ::new (static_cast<void*>(item(tail + i))) T(std::move(*first));
+
+            if (count)
+                _tail.store(tail + count, std::memory_order_release);
+
+            return count;
+        }
+
+        /**
+         * @brief 仅消费者线程调用
+         *
+         */
+        bool try_pop(T& v)
+        {
+            size_t head = _head.load(std::memory_order_relaxed);
+            if (readable(head, 1) == 0)
+                return false;
+
+            T* p = item(head);
+            v = std::move(*p);
+            p->~T();
+            _head.store(head + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        /**
+         * @brief 仅消费者线程调用, 取出最多 max 个元素后一次性归还槽位
+         *
+         * @return size_t 取出的元素个数
+         */
+        template<typename OutIt>
+        size_t pop_bulk(OutIt out, size_t max)
+        {
+            size_t head = _head.load(std::memory_order_relaxed);
+            size_t count = readable(head, max);
+            if (count > max)
+                count = max;
+
+            for (size_t i = 0; i < count; ++i, ++out)
+            {
+                T* p = item(head + i);
+                *out = std::move(*p);
+                p->~T();
+            }
+
+            if (count)
+                _head.store(head + count, std::memory_order_release);
+
+            return count;
+        }
+
+        size_t capacity() const noexcept
+        {
+            return _mask + 1;
+        }
+
+        bool empty() const noexcept
+        {
+            return size() == 0;
+        }
+
+        size_t size() const noexcept
+        {
+            size_t head = _head.load(std::memory_order_relaxed);
+            size_t tail = _tail.load(std::memory_order_relaxed);
+            return tail > head ? tail - head : 0;
+        }
+};
+
+}
+
+#endif // __JUSTSPSCQUEUE_H__
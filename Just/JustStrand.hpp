@@ -0,0 +1,175 @@
+
+#ifndef __JUSTSTRAND_H__
+#define __JUSTSTRAND_H__
+
+#include <cstddef>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <utility>
+#include <type_traits>
+
+#include "JustConfig.hpp"
+#include "JustTask.hpp"
+#include "JustThreadPool.h"
+
+
+namespace Just{
+
+/**
+ * @brief 绑定到线程池的串行执行器, 提交到同一个 Strand 的任务按 FIFO 顺序逐个执行, 互不重叠
+ *
+ * 任务放入无锁的多生产者单消费者邮箱, 入队只有一次 exchange 和一次 fetch_add.
+ * 邮箱从空变为非空的提交者向线程池投递一次排空任务, 之后由排空任务连续执行, 邮箱为空时立即让出线程,
+ * 因此没有待执行任务的 Strand 不占用任何线程. 每执行 BATCH 个任务重新排队一次, 避免独占线程.
+ * Strand 可以复制, 副本共享同一个邮箱; 最后一个副本析构后, 已提交的任务仍会执行完.
+ */
+class Strand final
+{
+    public:
+        static constexpr const size_t BATCH = 64; // 一次排空最多连续执行的任务数
+
+    private:
+        struct Node
+        {
+            std::atomic<Node*> next;
+            Task task;
+
+            Node() noexcept
+                : next { nullptr }
+            {}
+
+            explicit Node(Task&& t) noexcept
+                : next { nullptr }
+                , task { std::move(t) }
+            {}
+        };
+
+        /**
+         * @brief Vyukov 的 MPSC 链表队列, head 为哑节点, 只有排空任务访问
+         *
+         */
+        struct Impl
+        {
+            ThreadPool& pool;
+            std::atomic<Node*> tail;          // 生产者交换
+            std::atomic<size_t> pending;      // 已提交未执行完的任务数
+            char _pad0[CACHE_LINE_SIZE - sizeof(std::atomic<Node*>) - sizeof(std::atomic<size_t>)];
+            Node* head;                       // 只有排空任务读写
+
+            explicit Impl(ThreadPool& p)
+                : pool(p)
+                , tail { nullptr }
+                , pending { 0 }
+                , head { new Node() }
+            {
+                tail.store(head, std::memory_order_relaxed);
+            }
+
+            ~Impl()
+            {
+                // 排空任务持有 shared_ptr, 走到这里时邮箱中只剩哑节点
+                while (head) {
+                    Node* next = head->next.load(std::memory_order_relaxed);
+                    delete head;
+                    head = next;
+                }
+            }
+
+            static void push(const std::shared_ptr<Impl>& impl, Task&& t)
+            {
+                Node* node = new Node(std::move(t));
+                Node* prev = impl->tail.exchange(node, std::memory_order_acq_rel);
+                prev->next.store(node, std::memory_order_release);
+
+                if (impl->pending.fetch_add(1, std::memory_order_acq_rel) == 0)
+                    schedule(std::shared_ptr<Impl>(impl));
+            }
+
+            static void schedule(std::shared_ptr<Impl>&& impl)
+            {
+                ThreadPool& pool = impl->pool;
+                pool.post([self = std::move(impl)]() mutable {
+                    if (!self->drain())
+                        schedule(std::move(self));
+                });
+            }
+
+            /**
+             * @brief 连续执行邮箱中的任务
+             *
+             * @return true 邮箱已空, false 执行了 BATCH 个任务后还有剩余
+             */
+            bool drain()
+            {
+                for (size_t n = 0; n < BATCH; n++)
+                {
+                    Node* next = head->next.load(std::memory_order_acquire);
+                    while (nullptr == next) {
+                        // 计数已经可见, 但更早的生产者交换了 tail 还没有链接
+                        cpu_relax();
+                        next = head->next.load(std::memory_order_acquire);
+                    }
+
+                    Task task(std::move(next->task));
+                    delete head;
+                    head = next;
+                    task();
+
+                    if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                        return true;
+                }
+
+                // 还有任务, 排到线程池队尾, 让其他任务先执行
+                return false;
+            }
+        };
+
+        std::shared_ptr<Impl> _impl;
+
+    public:
+        explicit Strand(ThreadPool& pool)
+            : _impl { std::make_shared<Impl>(pool) }
+        {}
+
+        /**
+         * @brief 提交任务但不创建 future, 与 ThreadPool::post 一样不捕获异常
+         *
+         */
+        template<typename Func, typename... Args>
+        void post(Func&& func, Args&&... args)
+        {
+            Impl::push(_impl, Task(detail::make_invoker(std::forward<Func>(func), std::forward<Args>(args)...)));
+        }
+
+        template<typename Func, typename... Args>
+        std::future<std::result_of_t<std::decay_t<Func>(std::decay_t<Args>...)>>
+            run(Func&& func, Args&&... args)
+        {
+            using ret_t = typename std::result_of_t<std::decay_t<Func>(std::decay_t<Args>...)>;
+            std::packaged_task<ret_t()> pkg_task(detail::make_invoker(std::forward<Func>(func), std::forward<Args>(args)...));
+            std::future<ret_t> fut = pkg_task.get_future();
+
+            Impl::push(_impl, Task(std::move(pkg_task)));
+
+            return fut;
+        }
+
+        /**
+         * @brief 已提交但尚未执行完的任务数
+         *
+         */
+        size_t pending() const noexcept
+        {
+            return _impl->pending.load(std::memory_order_relaxed);
+        }
+
+        ThreadPool& pool() const noexcept
+        {
+            return _impl->pool;
+        }
+};
+
+}
+
+#endif // __JUSTSTRAND_H__
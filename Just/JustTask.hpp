@@ -0,0 +1,226 @@
+
+#ifndef __JUSTTASK_H__
+#define __JUSTTASK_H__
+
+#include <cstddef>
+#include <new>
+#include <tuple>
+#include <utility>
+#include <type_traits>
+
+#include "JustConfig.hpp"
+
+
+namespace Just{
+
+namespace detail{
+
+/**
+ * @brief 保存可调用对象及其参数, 调用时以右值传入, 与 std::thread 的语义一致
+ *
+ */
+template<typename Func, typename... Args>
+class Invoker
+{
+    std::tuple<Func, Args...> _tuple;
+
+    template<size_t... I>
+    decltype(auto) invoke(std::index_sequence<I...>)
+    {
+        return std::move(std::get<0>(_tuple))(std::move(std::get<I + 1>(_tuple))...);
+    }
+
+public:
+    template<typename F, typename... A>
+    explicit Invoker(F&& func, A&&... args)
+        : _tuple { std::forward<F>(func), std::forward<A>(args)... }
+    {}
+
+    decltype(auto) operator()()
+    {
+        return invoke(std::index_sequence_for<Args...>{});
+    }
+};
+
+template<typename Func, typename... Args>
+Invoker<std::decay_t<Func>, std::decay_t<Args>...> make_invoker(Func&& func, Args&&... args)
+{
+    return Invoker<std::decay_t<Func>, std::decay_t<Args>...>(std::forward<Func>(func), std::forward<Args>(args)...);
+}
+
+}
+
+/**
+ * @brief 只可移动的类型擦除任务, 小闭包直接存放在对象内部, 整个对象占一个缓存行
+ *
+ * 闭包大小不超过 INLINE_SIZE 且移动构造不抛异常时不分配内存, 否则在堆上分配一次.
+ */
+class Task final
+{
+    public:
+        static constexpr const size_t INLINE_SIZE = CACHE_LINE_SIZE - sizeof(void*);
+
+    private:
+        struct VTable
+        {
+            void (*invoke)(void* storage);
+            void (*move)(void* dst, void* src); // 移动到 dst 并销毁 src
+            void (*destroy)(void* storage);
+        };
+
+        template<typename F>
+        struct InlineOps
+        {
+            static void invoke(void* storage)
+            {
+                (*static_cast<F*>(storage))();
+            }
+
+            static void move(void* dst, void* src) noexcept
+            {
+                ::new (dst) F(std::move(*static_cast<F*>(src)));
+                static_cast<F*>(src)->~F();
+            }
+
+            static void destroy(void* storage) noexcept
+            {
+                static_cast<F*>(storage)->~F();
+            }
+
+            static const VTable vtable;
+        };
+
+        template<typename F>
+        struct HeapOps
+        {
+            static void invoke(void* storage)
+            {
+                (**static_cast<F**>(storage))();
+            }
+
+            static void move(void* dst, void* src) noexcept
+            {
+                *static_cast<F**>(dst) = *static_cast<F**>(src);
+            }
+
+            static void destroy(void* storage) noexcept
+            {
+                delete *static_cast<F**>(storage);
+            }
+
+            static const VTable vtable;
+        };
+
+        template<typename F>
+        using fits_inline = std::integral_constant<bool,
+            sizeof(F) <= INLINE_SIZE
+            && alignof(F) <= alignof(void*)
+            && std::is_nothrow_move_constructible<F>::value>;
+
+        alignas(void*) unsigned char _storage[INLINE_SIZE];
+        const VTable* _vtable;
+
+        template<typename F>
+        void assign(F&& func, std::true_type /* inline */)
+        {
+            using Fn = std::decay_t<F>;
+            ::new (static_cast<void*>(_storage)) Fn(std::forward<F>(func));
+            _vtable = &InlineOps<Fn>::vtable;
+        }
+
+        template<typename F>
+        void assign(F&& func, std::false_type /* inline */)
+        {
+            using Fn = std::decay_t<F>;
+            *reinterpret_cast<Fn**>(_storage) = new Fn(std::forward<F>(func));
+            _vtable = &HeapOps<Fn>::vtable;
+        }
+
+        void reset() noexcept
+        {
+            if (_vtable) {
+                _vtable->destroy(_storage);
+                _vtable = nullptr;
+            }
+        }
+
+    public:
+        Task() noexcept
+            : _vtable { nullptr }
+        {}
+
+        Task(std::nullptr_t) noexcept
+            : _vtable { nullptr }
+        {}
+
+        template<typename F, typename = std::enable_if_t<!std::is_same<std::decay_t<F>, Task>::value>>
+        Task(F&& func)
+            : _vtable { nullptr }
+        {
+            assign(std::forward<F>(func), fits_inline<std::decay_t<F>>{});
+        }
+
+        Task(Task&& other) noexcept
+            : _vtable { other._vtable }
+        {
+            if (_vtable) {
+                _vtable->move(_storage, other._storage);
+                other._vtable = nullptr;
+            }
+        }
+
+        Task& operator=(Task&& other) noexcept
+        {
+            if (this != &other) {
+                reset();
+                if (other._vtable) {
+                    other._vtable->move(_storage, other._storage);
+                    _vtable = other._vtable;
+                    other._vtable = nullptr;
+                }
+            }
+            return *this;
+        }
+
+        Task& operator=(std::nullptr_t) noexcept
+        {
+            reset();
+            return *this;
+        }
+
+        Task(const Task&) = delete;
+        Task& operator=(const Task&) = delete;
+
+        ~Task()
+        {
+            reset();
+        }
+
+        explicit operator bool() const noexcept
+        {
+            return _vtable != nullptr;
+        }
+
+        void operator()()
+        {
+            _vtable->invoke(_storage);
+        }
+};
+
+template<typename F>
+const Task::VTable Task::InlineOps<F>::vtable = {
+    &Task::InlineOps<F>::invoke,
+    &Task::InlineOps<F>::move,
+    &Task::InlineOps<F>::destroy,
+};
+
+template<typename F>
+const Task::VTable Task::HeapOps<F>::vtable = {
+    &Task::HeapOps<F>::invoke,
+    &Task::HeapOps<F>::move,
+    &Task::HeapOps<F>::destroy,
+};
+
+}
+
+#endif // __JUSTTASK_H__
@@ -0,0 +1,229 @@
+
+#ifndef __JUSTTASKGRAPH_H__
+#define __JUSTTASKGRAPH_H__
+
+#include <cstddef>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <stdexcept>
+#include <exception>
+#include <functional>
+
+#include "JustFuture.hpp"
+
+
+namespace Just{
+
+/**
+ * @brief 可重复运行的任务依赖图 (DAG)
+ *
+ * 构建一次后可以多次 run. 每个节点有一个剩余前驱计数, 前驱完成时原子递减, 减到 0 的节点
+ * 投递到线程池; 最后一个就绪的后继直接在当前线程继续执行, 少走一次队列. 没有线程会阻塞等待.
+ * 节点抛出异常后, 尚未开始的节点不再执行, 异常传给 run 返回的 Future.
+ * 运行期间不可修改图, 也不可再次 run.
+ */
+class TaskGraph final
+{
+    public:
+        using Node = size_t;
+
+    private:
+        static constexpr const Node NONE = static_cast<Node>(-1);
+
+        struct NodeData
+        {
+            std::function<void()> func;
+            std::vector<Node> successors;
+            size_t dependencies;          // 前驱数量
+            std::atomic<size_t> remain;   // 本次运行中尚未完成的前驱数量
+
+            explicit NodeData(std::function<void()>&& f)
+                : func { std::move(f) }
+                , dependencies { 0 }
+                , remain { 0 }
+            {}
+        };
+
+        std::vector<std::unique_ptr<NodeData>> _nodes;
+        std::vector<Node> _roots;         // 没有前驱的节点, 由 validate 计算
+        bool _validated;
+        bool _acyclic;
+
+        // 以下为一次运行的状态
+        std::atomic<bool> _running;
+        std::atomic<bool> _failed;
+        std::atomic<size_t> _pending;     // 尚未完成的节点数
+        std::mutex _error_mutex;
+        std::exception_ptr _error;
+        Promise<void> _promise;
+        ThreadPool* _pool;
+
+        bool validate()
+        {
+            if (_validated)
+                return _acyclic;
+
+            // Kahn 算法, 能全部弹出说明无环
+            std::vector<size_t> degree(_nodes.size());
+            std::vector<Node> ready;
+            _roots.clear();
+            for (Node i = 0; i < _nodes.size(); i++)
+            {
+                degree[i] = _nodes[i]->dependencies;
+                if (degree[i] == 0) {
+                    _roots.push_back(i);
+                    ready.push_back(i);
+                }
+            }
+
+            size_t visited = 0;
+            while (!ready.empty())
+            {
+                Node node = ready.back();
+                ready.pop_back();
+                ++visited;
+                for (Node succ : _nodes[node]->successors)
+                {
+                    if (--degree[succ] == 0)
+                        ready.push_back(succ);
+                }
+            }
+
+            _validated = true;
+            _acyclic = visited == _nodes.size();
+            return _acyclic;
+        }
+
+        void finish_one()
+        {
+            if (_pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                return;
+
+            // 先取出结果再标记结束, 之后本对象可能立即被再次 run
+            Promise<void> promise = std::move(_promise);
+            std::exception_ptr error = std::move(_error);
+            _error = nullptr;
+            _running.store(false, std::memory_order_release);
+
+            if (error)
+                promise.set_exception(error);
+            else
+                promise.set_value();
+        }
+
+        void execute(Node node)
+        {
+            while (node != NONE)
+            {
+                NodeData& data = *_nodes[node];
+                if (!_failed.load(std::memory_order_relaxed)) {
+                    try {
+                        data.func();
+                    }
+                    catch (...) {
+                        std::lock_guard<std::mutex> locker(_error_mutex);
+                        if (!_error)
+                            _error = std::current_exception();
+                        _failed.store(true, std::memory_order_relaxed);
+                    }
+                }
+
+                Node next = NONE;
+                for (Node succ : data.successors)
+                {
+                    if (_nodes[succ]->remain.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                        continue;
+                    if (next != NONE)
+                        _pool->post([this, next]() { execute(next); });
+                    next = succ;
+                }
+
+                // next 仍计入 _pending, 这里不会触发结束
+                finish_one();
+                node = next;
+            }
+        }
+
+    public:
+        TaskGraph()
+            : _validated { true }
+            , _acyclic { true }
+            , _running { false }
+            , _failed { false }
+            , _pending { 0 }
+            , _pool { nullptr }
+        {}
+
+        TaskGraph(TaskGraph&&) = delete;
+        TaskGraph(const TaskGraph&) = delete;
+        TaskGraph& operator=(TaskGraph&&) = delete;
+        TaskGraph& operator=(const TaskGraph&) = delete;
+
+        Node add(std::function<void()> func)
+        {
+            _nodes.emplace_back(new NodeData(std::move(func)));
+            _validated = false;
+            return _nodes.size() - 1;
+        }
+
+        /**
+         * @brief 添加依赖: before 完成后 after 才能开始
+         *
+         */
+        void precede(Node before, Node after)
+        {
+            _nodes[before]->successors.push_back(after);
+            _nodes[after]->dependencies++;
+            _validated = false;
+        }
+
+        size_t size() const noexcept
+        {
+            return _nodes.size();
+        }
+
+        /**
+         * @brief 在 pool 中运行整个图; 图有环或上一次运行尚未结束时返回的 Future 带 logic_error
+         *
+         */
+        Future<void> run(ThreadPool& pool)
+        {
+            Promise<void> promise(&pool);
+            Future<void> result = promise.get_future();
+
+            if (_running.exchange(true, std::memory_order_acq_rel)) {
+                promise.set_exception(std::make_exception_ptr(std::logic_error("TaskGraph is already running")));
+                return result;
+            }
+
+            if (!validate()) {
+                _running.store(false, std::memory_order_release);
+                promise.set_exception(std::make_exception_ptr(std::logic_error("TaskGraph has a cycle")));
+                return result;
+            }
+
+            if (_nodes.empty()) {
+                _running.store(false, std::memory_order_release);
+                promise.set_value();
+                return result;
+            }
+
+            for (auto& it : _nodes)
+                it->remain.store(it->dependencies, std::memory_order_relaxed);
+            _failed.store(false, std::memory_order_relaxed);
+            _pending.store(_nodes.size(), std::memory_order_relaxed);
+            _pool = &pool;
+            _promise = std::move(promise);
+
+            for (Node root : _roots)
+                pool.post([this, root]() { execute(root); });
+
+            return result;
+        }
+};
+
+}
+
+#endif // __JUSTTASKGRAPH_H__
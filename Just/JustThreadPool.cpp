@@ -1,60 +1,776 @@
 ﻿
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <ratio>
 #include <thread>
 #include <vector>
+#include <iterator>
 //#include <shared_mutex>
 #include <mutex>
 
 #include "JustThreadPool.h"
-#include "JustConcurrentQueue.hpp"
+#include "JustBasicThreadPool.hpp"
+#include "JustWorkStealingDeque.hpp"
+#include "JustTopology.hpp"
+#include "JustIdle.hpp"
+#ifdef JUST_ENABLE_TRACE
+#include <cstdio>
+#include "JustTrace.hpp"
+#endif
 using namespace Just;
 
 
 namespace
 {
     const size_t KERNAL_COUNT = std::thread::hardware_concurrency();
+    const std::chrono::microseconds HELP_WAIT(200); // help_while 没有任务时每次休眠的上限, 等待的结果完成时没有通知
+    const size_t SPARE_TASK_COUNT = 256; // 每个线程缓存的空闲任务对象上限
+    const size_t BATCH_COUNT = 16;       // 每次从共享队列批量取出的任务上限
+    const std::chrono::milliseconds ELASTIC_INTERVAL(10); // 弹性模式下检查负载的间隔
+    const size_t ELASTIC_SAMPLES = 3;                     // 连续多少次超过阈值才增加线程
+    const uint32_t METRICS_SAMPLE = 256; // 每个提交线程每隔多少个任务采样一次排队与执行耗时
+#ifdef JUST_ENABLE_TRACE
+    const size_t TRACE_CAPACITY = 1 << 16;     // 每个工作者保留的最近事件数, 2 的幂
+    const uint64_t TRACE_EXTERNAL_BASE = 1000; // 线程池外的提交线程在追踪中的编号起点
+#endif
     bool usefulThreadHint(size_t thread_hint)
     {
         return (thread_hint > 0) && (thread_hint <= KERNAL_COUNT * 2);
     }
+
+    // 其余字段取 Options 的默认值
+    ThreadPool::Options make_options(size_t thread_hint, ThreadPool::Scheduler sched)
+    {
+        ThreadPool::Options opts;
+        opts.thread_hint = thread_hint;
+        opts.sched = sched;
+        return opts;
+    }
+
+    /**
+     * @brief 队列中保存的任务; 编译追踪时旁边带一个追踪头, 入队信息不必再包装一次任务
+     *
+     */
+    struct Job
+    {
+        Task task;
+#ifdef JUST_ENABLE_TRACE
+        uint64_t trace_id = 0;      // 提交线程编号 << 40 | 序号
+        uint64_t trace_enqueue = 0; // 入队时间, 为 0 表示未追踪
+#endif
+
+        Job() = default;
+
+        Job(Task&& t) noexcept
+            : task { std::move(t) }
+        {}
+    };
+
+#ifdef JUST_BLOCK_QUEUE
+    using QueuePolicy = policy::BlockQueue;
+    const ThreadPool::QueueType QUEUE_TYPE = ThreadPool::QueueType::Block;
+#else
+    using QueuePolicy = policy::LinkedQueue;
+    const ThreadPool::QueueType QUEUE_TYPE = ThreadPool::QueueType::Linked;
+#endif
+
+    /**
+     * @brief 共享任务队列, 编译时按 JUST_BLOCK_QUEUE 选择 BasicThreadPool 的块队列或链表队列策略
+     *
+     */
+    class TaskQueue : public QueuePolicy::queue<Job>
+    {
+    public:
+        bool empty() const
+        {
+            return size() == 0;
+        }
+    };
+
+    struct Worker
+    {
+        WorkStealingDeque<Job*> local_queue;  // 本地队列, 只有本线程 push/pop
+        std::vector<Job*> spare_jobs;         // 本地队列任务对象的缓存, 避免反复分配
+        std::vector<Job> batch;               // 从共享队列批量取出时的临时缓冲
+        std::vector<TaskQueue::consumer> customers; // 每个共享队列的消费者令牌, 先优先级队列后节点队列
+        size_t served;                        // 距离上次按老化策略取任务执行过的任务数
+        uint32_t seed;                        // 选择窃取对象的随机数种子
+        const void* owner;                    // 所属线程池
+        std::atomic<bool> running;            // 是否有线程在使用该工作者
+        std::vector<int> cpus;                // 绑定的 CPU, 为空时不绑定
+        size_t node;                          // 所属 NUMA 节点
+        size_t index;                         // 在 worker_vec 中的下标, 也是在 metrics 中的下标
+        size_t slot;                          // 运行期间在 Data::running_vec 中的下标, 由 running_mutex 保护
+        policy::TimedMetrics* metrics;        // 所属线程池的统计
+#ifdef JUST_ENABLE_TRACE
+        std::atomic<TraceRing*> trace;        // 开启追踪后指向该工作者的事件缓冲区
+#endif
+
+        Worker(const void* pool, size_t index, policy::TimedMetrics* metrics, const std::vector<TaskQueue*>& queues)
+            : served { 0 }
+            , seed { static_cast<uint32_t>(index) * 2654435761u + 1u }
+            , owner { pool }
+            , running { false }
+            , node { 0 }
+            , index { index }
+            , slot { 0 }
+            , metrics { metrics }
+#ifdef JUST_ENABLE_TRACE
+            , trace { nullptr }
+#endif
+        {
+            for (TaskQueue* it : queues)
+                customers.emplace_back(it->make_consumer());
+        }
+
+        ~Worker()
+        {
+            for (Job* it : spare_jobs)
+                delete it;
+        }
+
+        Job* make_job(Job&& j)
+        {
+            if (spare_jobs.empty())
+                return new Job(std::move(j));
+
+            Job* job = spare_jobs.back();
+            spare_jobs.pop_back();
+            *job = std::move(j);
+            return job;
+        }
+
+        void recycle_job(Job* job)
+        {
+            if (spare_jobs.size() < SPARE_TASK_COUNT)
+                spare_jobs.push_back(job);
+            else
+                delete job;
+        }
+
+        uint32_t next_random() noexcept
+        {
+            // xorshift32
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            return seed;
+        }
+    };
+
+    thread_local Worker* tls_worker = nullptr; // 当前线程对应的工作者, 非线程池线程为空
+    thread_local uint32_t tls_submitted = 0;   // 当前线程提交的任务数, 用于采样
+#ifdef JUST_ENABLE_TRACE
+    thread_local uint64_t tls_trace_thread = 0; // 线程池外的线程在追踪中的编号, 第一次提交时分配
+    thread_local uint64_t tls_trace_seq = 0;
+    std::atomic<uint64_t> trace_thread_serial(TRACE_EXTERNAL_BASE);
+#endif
+
+    /**
+     * @brief 每 METRICS_SAMPLE 个任务包装一个, 记录入队时间, 执行时统计排队与执行耗时
+     *
+     * 包装后的任务超出内联大小, 只有被采样的任务多一次分配, 其余任务不读时钟.
+     */
+    void wrap_sampled(Task& t)
+    {
+        int64_t stamp = policy::TimedMetrics::now();
+        t = Task([inner = std::move(t), stamp]() mutable {
+            Worker* self = tls_worker;
+            if (!self)
+            {
+                inner();
+                return;
+            }
+
+            int64_t start = self->metrics->sample_begin(self->index, stamp);
+            inner();
+            self->metrics->sample_end(self->index, start);
+        });
+    }
+
+    inline void sample_task(Task& t)
+    {
+        if (++tls_submitted % METRICS_SAMPLE == 0)
+            wrap_sampled(t);
+    }
+
+#ifdef JUST_ENABLE_TRACE
+    inline void trace_park(Worker& self, uint64_t parked)
+    {
+        TraceRing* ring = self.trace.load(std::memory_order_relaxed);
+        if (parked && ring)
+            ring->push(TraceRecord::Kind::Park, 0, self.index, parked, trace_now(), 0);
+    }
+#endif
+
+    // 执行取出的任务; 带追踪头时在前后读时钟, 写入本工作者的事件缓冲区
+    inline void run_job(Worker& self, Job& job)
+    {
+#ifdef JUST_ENABLE_TRACE
+        TraceRing* ring = job.trace_enqueue ? self.trace.load(std::memory_order_acquire) : nullptr;
+        if (ring)
+        {
+            uint64_t start = trace_now();
+            job.task();
+            ring->push(TraceRecord::Kind::Task, job.trace_id, job.trace_id >> 40, job.trace_enqueue, start, trace_now());
+            return;
+        }
+#else
+        (void)self;
+#endif
+        job.task();
+    }
 }
 
 struct ThreadPool::Data
 {
-    ConcurrentQueue<Task> task_queue; // 工作队列
+    TaskQueue task_queue[PRIORITY_COUNT]; // 工作队列, 每个优先级一个, 下标越小优先级越高
+    std::vector<std::unique_ptr<TaskQueue>> node_queue; // 每个 NUMA 节点一个, 存放提交到该节点的普通优先级任务
+    CpuTopology topology;
+    Placement placement;
+    std::vector<int> placement_cpus;
+    size_t aging_interval;
 
-    size_t thread_size;
-    std::vector<std::thread> thread_vec;  // 线程池
+    std::atomic<size_t> thread_size;      // 固定模式下的线程数, 弹性模式下的下限
+    size_t max_threads;                   // 弹性模式下的上限, 固定模式下等于 thread_size
+    bool elastic;
+    size_t grow_threshold;
+    std::chrono::milliseconds keep_alive;
+    size_t busy_samples;                  // 连续超过阈值的采样次数, 只在定时线程中访问
+    std::atomic<size_t> active_count;     // 正在运行的线程数
+    std::atomic<size_t> retire_count;     // resize 缩小后等待退出的线程数
+    std::vector<std::thread> thread_vec;  // 线程池, 按最大线程数预留, 退出的线程在下次增加时回收
+    std::vector<std::unique_ptr<Worker>> worker_vec; // 与 thread_vec 一一对应
+    std::unique_ptr<std::atomic<Worker*>[]> running_vec; // 正在运行的工作者, 前 running_size 个有效; 窃取与 has_task 只遍历这些
+    std::atomic<size_t> running_size;
+    std::mutex running_mutex;             // 修改 running_vec 时持有, 读取不加锁
     std::mutex pool_mutex;
+    Scheduler sched;
 
     std::atomic<Status> stat;
     std::atomic<Order> order;
+
+    DynamicIdle idle; // 空闲线程的等待与唤醒, 按 Options 选择策略
+
+    std::unique_ptr<TimerWheel> timers; // 延迟与周期任务, 到期后批量投递到普通优先级队列
+
+    policy::TimedMetrics metrics; // 每个工作者的统计, 下标与 worker_vec 一致, start 时重建
+    PoolMetrics history; // stop 时已退出线程的累计统计, 由 pool_mutex 保护
+
+#ifdef JUST_ENABLE_TRACE
+    std::atomic<bool> tracing { false };
+    std::vector<std::unique_ptr<TraceRing>> trace_rings; // 与 worker_vec 的下标对应, stop 后保留
+    TraceClock trace_clock;
+
+    void attach_trace();
+    void trace_job(Job& job);
+#endif
+
+    explicit Data(const Options& opts)
+        : idle { opts.idle, opts.spin_count, opts.yield_count, opts.backoff_min, opts.backoff_max }
+    {}
+
+    TaskQueue& lane(Priority prio)
+    {
+        return task_queue[static_cast<size_t>(prio)];
+    }
+
+    // 下标小于 PRIORITY_COUNT 为优先级队列, 之后为节点队列, 与 Worker::customers 一致
+    TaskQueue& queue_at(size_t index)
+    {
+        return index < PRIORITY_COUNT ? task_queue[index] : *node_queue[index - PRIORITY_COUNT];
+    }
+
+    void init_nodes();
+    void place_worker(Worker& worker, size_t index);
+
+    bool pop_task(Worker& self, Job& job);
+    bool pop_lane(Worker& self, Job& job, size_t index);
+    bool pop_batch(Worker& self, Job& job, size_t index);
+    bool steal_task(Worker& self, Job& job);
+    bool has_task() const;
+    template<typename T>
+    void enqueue_bulk(T* items, size_t count);
+    void drain_local_queues();
+    void drain_worker(Worker& self);
+    void collect_metrics(PoolMetrics& out) const;
+
+    bool spawn_worker(ThreadPool* pool);
+    void add_running(Worker& worker);
+    void remove_running(Worker& worker);
+    bool try_retire();
+    bool try_shrink();
+    void check_load(ThreadPool* pool);
 };
 
-void ThreadPool::work_func()
+bool ThreadPool::Data::pop_task(Worker& self, Job& job)
+{
+    const size_t normal = static_cast<size_t>(Priority::Normal);
+
+    if (aging_interval && ++self.served >= aging_interval)
+    {
+        // 老化: 先从最低的非空优先级取一个, 防止低优先级任务饿死
+        self.served = 0;
+        for (size_t i = PRIORITY_COUNT; i-- > 0; )
+        {
+            if (pop_lane(self, job, i))
+                return true;
+        }
+    }
+
+    for (size_t i = 0; i < normal; i++)
+    {
+        if (pop_lane(self, job, i))
+            return true;
+    }
+
+    // 本地队列中只有普通优先级的任务
+    Job* local = nullptr;
+    if (self.local_queue.pop(local))
+    {
+        job = std::move(*local);
+        self.recycle_job(local);
+        return true;
+    }
+
+    // 先取本节点的队列, 再取公共队列, 其他节点的队列只在空闲时取
+    if (pop_batch(self, job, PRIORITY_COUNT + self.node))
+        return true;
+
+    if (pop_batch(self, job, normal))
+        return true;
+
+    if (steal_task(self, job))
+        return true;
+
+    for (size_t i = 0; i < node_queue.size(); i++)
+    {
+        if (i != self.node && pop_lane(self, job, PRIORITY_COUNT + i))
+            return true;
+    }
+
+    for (size_t i = normal + 1; i < PRIORITY_COUNT; i++)
+    {
+        if (pop_lane(self, job, i))
+            return true;
+    }
+
+    return false;
+}
+
+bool ThreadPool::Data::pop_lane(Worker& self, Job& job, size_t index)
+{
+    TaskQueue& queue = queue_at(index);
+    if (queue.empty())
+        return false;
+
+    return queue.pop_bulk(&job, 1, self.customers[index]) == 1;
+}
+
+bool ThreadPool::Data::pop_batch(Worker& self, Job& job, size_t index)
+{
+    // 只批量取普通优先级的任务; 按线程数平分共享队列中的任务, 避免一个线程把任务全部取走
+    TaskQueue& queue = queue_at(index);
+    if (queue.empty())
+        return false;
+
+    size_t active = active_count.load(std::memory_order_relaxed);
+    size_t max = queue.size() / (active ? active : 1);
+    max = std::min(std::max<size_t>(max, 1), BATCH_COUNT);
+
+    self.batch.clear();
+    if (queue.pop_bulk(std::back_inserter(self.batch), max, self.customers[index]) == 0)
+        return false;
+
+    // 其余任务放入本地队列, 两种调度方式下空闲线程都可以窃取, 当前任务阻塞时不会困住它们.
+    // 倒序放入, 本线程按出队顺序执行, 窃取者先取最后出队的
+    job = std::move(self.batch.front());
+    const size_t count = self.batch.size();
+    for (size_t i = count; i-- > 1; )
+    {
+        self.local_queue.push(self.make_job(std::move(self.batch[i])));
+    }
+    self.batch.clear();
+
+    if (count > 1)
+        idle.notify_one();
+    return true;
+}
+
+bool ThreadPool::Data::steal_task(Worker& self, Job& job)
+{
+    // 共享队列模式下本地队列中只有批量取出的任务; 没有运行的工作者本地队列为空, 不必窃取
+    const size_t count = running_size.load(std::memory_order_acquire);
+    if (count < 2)
+        return false;
+
+    // 前一半次数只窃取同一节点的线程
+    Job* stolen = nullptr;
+    for (size_t i = 0; i < count * 2; i++)
+    {
+        Worker& victim = *running_vec[self.next_random() % count].load(std::memory_order_acquire);
+        if (&victim == &self || (i < count && victim.node != self.node))
+            continue;
+
+        if (victim.local_queue.steal(stolen))
+        {
+            job = std::move(*stolen);
+            self.recycle_job(stolen);
+            metrics.stole(self.index);
+            return true;
+        }
+    }
+
+    metrics.steal_failed(self.index);
+    return false;
+}
+
+bool ThreadPool::Data::has_task() const
+{
+    for (auto& it : task_queue)
+    {
+        if (!it.empty())
+            return true;
+    }
+
+    for (auto& it : node_queue)
+    {
+        if (!it->empty())
+            return true;
+    }
+
+    const size_t count = running_size.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!running_vec[i].load(std::memory_order_acquire)->local_queue.empty())
+            return true;
+    }
+
+    return false;
+}
+
+template<typename T>
+void ThreadPool::Data::enqueue_bulk(T* items, size_t count)
+{
+    // T 为 Task 或 Job, 都可以构造 Job
+    Worker* self = tls_worker;
+    if (self && self->owner == this && sched == Scheduler::WorkStealing)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            self->local_queue.push(self->make_job(std::move(items[i])));
+        }
+    }
+    else
+    {
+        lane(Priority::Normal).push_bulk(std::make_move_iterator(items), std::make_move_iterator(items + count));
+    }
+
+    if (count > 1)
+        idle.notify_all();
+    else
+        idle.notify_one();
+}
+
+void ThreadPool::Data::drain_local_queues()
+{
+    // 线程已全部退出, 将本地队列中剩余的任务放回普通优先级队列, 下次 start 后继续执行
+    TaskQueue& queue = lane(Priority::Normal);
+    Job* job = nullptr;
+    for (auto& it : worker_vec)
+    {
+        while (it->local_queue.steal(job))
+        {
+            queue.push(std::move(*job));
+            delete job;
+        }
+    }
+}
+
+void ThreadPool::Data::collect_metrics(PoolMetrics& out) const
 {
-    using namespace std::chrono_literals;
-    bool got = false;
-    Task task;
+    // 调用者持有 pool_mutex
+    out.total = history.total;
+    out.queue_wait = history.queue_wait;
+    out.execution = history.execution;
+    out.workers.clear();
+
+    LatencyHistogram queue_wait;
+    LatencyHistogram execution;
+    for (size_t i = 0; i < worker_vec.size(); i++)
+    {
+        WorkerMetrics worker;
+        metrics.snapshot(i, worker, queue_wait, execution);
+        worker.running = worker_vec[i]->running.load(std::memory_order_relaxed);
+        out.total.merge(worker);
+        out.workers.push_back(worker);
+        out.queue_wait.merge(queue_wait);
+        out.execution.merge(execution);
+    }
+}
+
+#ifdef JUST_ENABLE_TRACE
+void ThreadPool::Data::attach_trace()
+{
+    // 调用者持有 pool_mutex
+    for (size_t i = 0; i < worker_vec.size(); i++)
+    {
+        if (i >= trace_rings.size())
+        {
+            trace_rings.emplace_back(std::make_unique<TraceRing>(TRACE_CAPACITY));
+        }
+        worker_vec[i]->trace.store(trace_rings[i].get(), std::memory_order_release);
+    }
+}
+
+void ThreadPool::Data::trace_job(Job& job)
+{
+    // 线程池自己的线程以下标为编号, 其他线程从 TRACE_EXTERNAL_BASE 开始编号
+    Worker* self = tls_worker;
+    uint64_t thread = 0;
+    if (self && self->owner == this)
+    {
+        thread = self->index;
+    }
+    else
+    {
+        if (!tls_trace_thread)
+            tls_trace_thread = trace_thread_serial.fetch_add(1, std::memory_order_relaxed);
+        thread = tls_trace_thread;
+    }
+
+    job.trace_id = (thread << 40) | (++tls_trace_seq & ((uint64_t(1) << 40) - 1));
+    job.trace_enqueue = trace_now();
+}
+#endif
+
+void ThreadPool::Data::init_nodes()
+{
+    topology = detect_topology();
+    node_queue.clear();
+    for (size_t i = 0; i < topology.nodes.size(); i++)
+    {
+        node_queue.emplace_back(std::make_unique<TaskQueue>());
+    }
+}
+
+void ThreadPool::Data::place_worker(Worker& worker, size_t index)
+{
+    const size_t nodes = topology.nodes.size();
+    worker.cpus.clear();
+    worker.node = index % nodes;
+
+    switch (placement)
+    {
+    case Placement::Compact:
+    {
+        size_t pos = index % topology.cpu_count();
+        for (size_t i = 0; i < nodes; i++)
+        {
+            if (pos < topology.nodes[i].size())
+            {
+                worker.cpus.push_back(topology.nodes[i][pos]);
+                worker.node = i;
+                break;
+            }
+            pos -= topology.nodes[i].size();
+        }
+        break;
+    }
+    case Placement::Scatter:
+    {
+        const std::vector<int>& cpus = topology.nodes[worker.node];
+        worker.cpus.push_back(cpus[(index / nodes) % cpus.size()]);
+        break;
+    }
+    case Placement::CpuList:
+        if (!placement_cpus.empty())
+        {
+            int cpu = placement_cpus[index % placement_cpus.size()];
+            worker.cpus.push_back(cpu);
+            worker.node = topology.node_of(cpu);
+        }
+        break;
+    case Placement::NumaNode:
+        worker.cpus = topology.nodes[worker.node];
+        break;
+    default:
+        break;
+    }
+}
+
+void ThreadPool::Data::drain_worker(Worker& self)
+{
+    // 线程提前退出, 本地队列中剩余的任务交给其他线程
+    TaskQueue& queue = lane(Priority::Normal);
+    Job* job = nullptr;
+    bool moved = false;
+    while (self.local_queue.pop(job))
+    {
+        queue.push(std::move(*job));
+        self.recycle_job(job);
+        moved = true;
+    }
+
+    // 退出前可能已经消耗了一次唤醒, 有任务时转交给其他线程
+    if (moved || has_task())
+        idle.notify_all();
+}
+
+bool ThreadPool::Data::spawn_worker(ThreadPool* pool)
+{
+    // 调用者持有 pool_mutex
+    for (size_t i = 0; i < worker_vec.size(); i++)
+    {
+        if (worker_vec[i]->running.load(std::memory_order_acquire))
+            continue;
+
+        if (thread_vec[i].joinable())
+            thread_vec[i].join(); // 已经退出的线程
+        worker_vec[i]->running.store(true, std::memory_order_relaxed);
+        active_count.fetch_add(1, std::memory_order_relaxed);
+        add_running(*worker_vec[i]);
+        thread_vec[i] = std::thread(&ThreadPool::work_func, pool, i);
+        return true;
+    }
+
+    return false;
+}
+
+void ThreadPool::Data::add_running(Worker& worker)
+{
+    std::lock_guard<std::mutex> locker(running_mutex);
+    size_t count = running_size.load(std::memory_order_relaxed);
+    worker.slot = count;
+    running_vec[count].store(&worker, std::memory_order_release);
+    running_size.store(count + 1, std::memory_order_release);
+}
+
+void ThreadPool::Data::remove_running(Worker& worker)
+{
+    // 把最后一个移到 worker 的位置后再缩小, 并发读取的线程不会漏掉被移动的工作者
+    std::lock_guard<std::mutex> locker(running_mutex);
+    size_t last = running_size.load(std::memory_order_relaxed) - 1;
+    Worker* moved = running_vec[last].load(std::memory_order_relaxed);
+    moved->slot = worker.slot;
+    running_vec[worker.slot].store(moved, std::memory_order_release);
+    running_size.store(last, std::memory_order_release);
+}
+
+bool ThreadPool::Data::try_retire()
+{
+    size_t count = retire_count.load(std::memory_order_relaxed);
+    while (count)
+    {
+        if (retire_count.compare_exchange_weak(count, count - 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+        {
+            active_count.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool ThreadPool::Data::try_shrink()
+{
+    size_t count = active_count.load(std::memory_order_relaxed);
+    while (count > thread_size.load(std::memory_order_relaxed))
+    {
+        if (active_count.compare_exchange_weak(count, count - 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+            return true;
+    }
+
+    return false;
+}
+
+void ThreadPool::Data::check_load(ThreadPool* pool)
+{
+    // 在定时线程中执行, 所有线程都阻塞时也能增加线程; 正在 stop 时跳过
+    std::unique_lock<std::mutex> locker(pool_mutex, std::try_to_lock);
+    if (!locker.owns_lock() || stat != Status::Running)
+        return;
+
+    size_t active = active_count.load(std::memory_order_relaxed);
+    if (pool->task_count() <= active * grow_threshold)
+    {
+        busy_samples = 0;
+        return;
+    }
+
+    if (++busy_samples >= ELASTIC_SAMPLES && active < max_threads)
+    {
+        busy_samples = 0;
+        spawn_worker(pool);
+    }
+}
+
+void ThreadPool::work_func(size_t index)
+{
+    size_t idle = 0;
+    Job job;
+    Worker& self = *d->worker_vec[index];
+    policy::TimedMetrics& metrics = d->metrics;
+    tls_worker = &self;
+    metrics.enter(index);
+    if (!self.cpus.empty())
+    {
+        pin_current_thread(self.cpus);
+    }
+
+    // 有任务或需要退出时不可休眠; 空闲策略先登记为等待者再检查, 与入队时的 notify 配合避免丢失唤醒
+    auto ready = [this]() {
+        return d->has_task() || d->order != Order::None || d->retire_count.load(std::memory_order_relaxed);
+    };
 
     for (;;)
     {
-        got = false;
-        task = nullptr;
+        if (d->retire_count.load(std::memory_order_relaxed) && d->try_retire())
+        {
+            d->drain_worker(self);
+            break;
+        }
 
-        got = d->task_queue.pop(task);
-        if (got)
+        job.task = nullptr;
+        if (d->pop_task(self, job))
         {
-            if (task)
+            idle = 0;
+            metrics.executed(index);
+            if (job.task)
             {
-                task();
+                run_job(self, job);
             }
         }
         else
         {
-            std::this_thread::sleep_for(100ms);
+            metrics.empty_pop(index);
+            if (!d->idle.parks(idle))
+            {
+                d->idle.idle(idle, ready);
+            }
+            else
+            {
+                metrics.park(index);
+#ifdef JUST_ENABLE_TRACE
+                uint64_t parked = d->tracing.load(std::memory_order_relaxed) ? trace_now() : 0;
+#endif
+                // 弹性模式下空闲超过 keep_alive 且线程数高于下限时退出
+                bool notified = true;
+                if (d->elastic)
+                    notified = d->idle.idle_for(idle, ready, d->keep_alive);
+                else
+                    d->idle.idle(idle, ready);
+                metrics.unpark(index);
+#ifdef JUST_ENABLE_TRACE
+                trace_park(self, parked);
+#endif
+                if (!notified && d->try_shrink())
+                {
+                    d->drain_worker(self);
+                    break;
+                }
+            }
         }
 
         if (d->order == Order::Stop)
@@ -63,55 +779,434 @@ void ThreadPool::work_func()
         }
         else if (d->order == Order::StopAndDone)
         {
-            if (d->task_queue.empty())
+            if (!d->has_task())
             {
                 break;
             }
         }
     }
+
+    metrics.leave(index);
+    tls_worker = nullptr;
+    d->remove_running(self);
+    self.running.store(false, std::memory_order_release);
+}
+
+void ThreadPool::task_enqueue(Task&& t, Priority prio)
+{
+    sample_task(t);
+    Job job(std::move(t));
+#ifdef JUST_ENABLE_TRACE
+    if (d->tracing.load(std::memory_order_relaxed))
+        d->trace_job(job);
+#endif
+    Worker* self = tls_worker;
+    if (prio == Priority::Normal && self && self->owner == d.get() && d->sched == Scheduler::WorkStealing)
+    {
+        // 线程池内部提交的普通任务放入本线程的本地队列
+        self->local_queue.push(self->make_job(std::move(job)));
+    }
+    else
+    {
+        d->lane(prio).push(std::move(job));
+    }
+    d->idle.notify_one();
 }
 
-void ThreadPool::task_enqueue(Task&& t)
+void ThreadPool::task_enqueue_node(Task&& t, size_t node)
 {
-    d->task_queue.push(std::move(t));
+    sample_task(t);
+    Job job(std::move(t));
+#ifdef JUST_ENABLE_TRACE
+    if (d->tracing.load(std::memory_order_relaxed))
+        d->trace_job(job);
+#endif
+    d->node_queue[node % d->node_queue.size()]->push(std::move(job));
+    d->idle.notify_one();
+}
+
+void ThreadPool::task_enqueue_bulk(Task* tasks, size_t count)
+{
+    if (count == 0)
+        return;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        sample_task(tasks[i]);
+    }
+
+#ifdef JUST_ENABLE_TRACE
+    // 追踪时先转成带追踪头的 Job 再按同样的方式入队
+    if (d->tracing.load(std::memory_order_relaxed))
+    {
+        std::vector<Job> jobs;
+        jobs.reserve(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            jobs.emplace_back(std::move(tasks[i]));
+            d->trace_job(jobs.back());
+        }
+        d->enqueue_bulk(jobs.data(), count);
+        return;
+    }
+#endif
+    d->enqueue_bulk(tasks, count);
+}
+
+TimerHandle ThreadPool::timer_add(std::chrono::steady_clock::time_point when, Task&& t)
+{
+    return d->timers->add_at(when, std::move(t));
+}
+
+TimerHandle ThreadPool::timer_add_every(std::chrono::steady_clock::duration period, std::function<void()>&& func)
+{
+    return d->timers->add_every(period, std::move(func));
+}
+
+void ThreadPool::timer_dispatch(void* ctx, Task* tasks, size_t count)
+{
+    static_cast<ThreadPool*>(ctx)->task_enqueue_bulk(tasks, count);
 }
 
 ThreadPool::ThreadPool()
-    : d{ std::make_unique<Data>() }
+    : ThreadPool(Options())
 {
-    d->thread_size = KERNAL_COUNT;
-    d->stat = Status::Inited;
-    d->order = Order::None;
-    start(d->thread_size);
 }
 
 ThreadPool::ThreadPool(size_t thread_hint)
-    : d{ std::make_unique<Data>() }
+    : ThreadPool(thread_hint, Scheduler::WorkStealing)
 {
-    d->thread_size = usefulThreadHint(thread_hint) ? thread_hint : KERNAL_COUNT;
+}
+
+ThreadPool::ThreadPool(size_t thread_hint, Scheduler sched)
+    : ThreadPool(make_options(thread_hint, sched))
+{
+}
+
+ThreadPool::ThreadPool(const Options& opts)
+    : d{ std::make_unique<Data>(opts) }
+{
+    d->timers = std::make_unique<TimerWheel>(&ThreadPool::timer_dispatch, this);
+    d->thread_size = usefulThreadHint(opts.thread_hint) ? opts.thread_hint : KERNAL_COUNT;
+    d->max_threads = opts.max_threads;
+    d->elastic = opts.max_threads > d->thread_size;
+    d->grow_threshold = opts.grow_threshold;
+    d->keep_alive = opts.keep_alive;
+    d->busy_samples = 0;
+    d->active_count = 0;
+    d->retire_count = 0;
+    d->running_size = 0;
+    d->sched = opts.sched;
+    d->aging_interval = opts.aging_interval;
+    d->placement = opts.placement;
+    d->placement_cpus = opts.cpus;
+    d->init_nodes();
     d->stat = Status::Inited;
     d->order = Order::None;
     start(d->thread_size);
+
+    if (d->elastic)
+    {
+        Data* data = d.get();
+        d->timers->add_every(ELASTIC_INTERVAL, [data, this]() { data->check_load(this); }, true);
+    }
 }
 
 ThreadPool::~ThreadPool()
 {
+    // 先停止定时线程, 之后不再有任务投递进来
+    d->timers.reset();
     stop(Order::StopAndDone);
 }
 
 size_t ThreadPool::thread_count() const
 {
-    return d->thread_size;
+    return d->thread_size.load(std::memory_order_relaxed);
+}
+
+size_t ThreadPool::active_thread_count() const
+{
+    return d->active_count.load(std::memory_order_relaxed);
+}
+
+size_t ThreadPool::max_thread_count() const
+{
+    return d->max_threads;
+}
+
+ThreadPool::Scheduler ThreadPool::scheduler() const
+{
+    return d->sched;
+}
+
+ThreadPool::QueueType ThreadPool::queue_type() const
+{
+    return QUEUE_TYPE;
 }
 
 size_t ThreadPool::task_count() const
 {
-    return d->task_queue.size();
+    size_t count = 0;
+    for (size_t i = 0; i < PRIORITY_COUNT; i++)
+    {
+        count += task_count(static_cast<Priority>(i));
+    }
+    return count;
+}
+
+size_t ThreadPool::node_count() const
+{
+    return d->node_queue.size();
+}
+
+PoolMetrics ThreadPool::metrics() const
+{
+    // 持有 pool_mutex, 期间 stop 不会释放工作者
+    PoolMetrics result;
+    std::lock_guard<std::mutex> locker(d->pool_mutex);
+    d->collect_metrics(result);
+    result.sample_interval = METRICS_SAMPLE;
+    result.threads = active_thread_count();
+    result.queued = task_count();
+    return result;
+}
+
+void ThreadPool::set_tracing(bool enable)
+{
+#ifdef JUST_ENABLE_TRACE
+    std::lock_guard<std::mutex> locker(d->pool_mutex);
+    if (enable)
+    {
+        d->attach_trace();
+    }
+    d->tracing.store(enable, std::memory_order_relaxed);
+#else
+    (void)enable;
+#endif
+}
+
+bool ThreadPool::dump_trace(const std::string& path) const
+{
+#ifdef JUST_ENABLE_TRACE
+    std::vector<std::vector<TraceRecord>> records;
+    double ns_per_tick = 1.0;
+    uint64_t origin = 0;
+    {
+        std::lock_guard<std::mutex> locker(d->pool_mutex);
+        for (auto& it : d->trace_rings)
+        {
+            records.emplace_back();
+            it->snapshot(records.back());
+        }
+        ns_per_tick = d->trace_clock.ns_per_tick();
+        origin = d->trace_clock.origin();
+    }
+
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (!file)
+        return false;
+
+    // 时间单位为微秒; 入队到开始之间用 flow 事件连接提交线程与工作者
+    auto us = [&](uint64_t tick) { return static_cast<double>(tick - origin) * ns_per_tick / 1000.0; };
+    std::vector<uint64_t> threads;
+    std::fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    std::fprintf(file, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":1,\"args\":{\"name\":\"Just::ThreadPool\"}}");
+    for (size_t w = 0; w < records.size(); w++)
+    {
+        std::fprintf(file, ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":\"worker %zu\"}}", w, w);
+        for (const TraceRecord& r : records[w])
+        {
+            if (r.kind == TraceRecord::Kind::Park)
+            {
+                std::fprintf(file, ",\n{\"ph\":\"X\",\"cat\":\"worker\",\"name\":\"parked\",\"pid\":1,\"tid\":%zu,\"ts\":%.3f,\"dur\":%.3f}",
+                             w, us(r.t0), us(r.t1) - us(r.t0));
+                continue;
+            }
+
+            std::fprintf(file, ",\n{\"ph\":\"X\",\"cat\":\"task\",\"name\":\"task\",\"pid\":1,\"tid\":%zu,\"ts\":%.3f,\"dur\":%.3f,"
+                               "\"args\":{\"id\":%llu,\"queued_us\":%.3f}}",
+                         w, us(r.t1), us(r.t2) - us(r.t1), static_cast<unsigned long long>(r.id), us(r.t1) - us(r.t0));
+            std::fprintf(file, ",\n{\"ph\":\"X\",\"cat\":\"queue\",\"name\":\"enqueue\",\"pid\":1,\"tid\":%llu,\"ts\":%.3f,\"dur\":0}",
+                         static_cast<unsigned long long>(r.thread), us(r.t0));
+            std::fprintf(file, ",\n{\"ph\":\"s\",\"cat\":\"queue\",\"name\":\"queued\",\"id\":%llu,\"pid\":1,\"tid\":%llu,\"ts\":%.3f}",
+                         static_cast<unsigned long long>(r.id), static_cast<unsigned long long>(r.thread), us(r.t0));
+            std::fprintf(file, ",\n{\"ph\":\"f\",\"bp\":\"e\",\"cat\":\"queue\",\"name\":\"queued\",\"id\":%llu,\"pid\":1,\"tid\":%zu,\"ts\":%.3f}",
+                         static_cast<unsigned long long>(r.id), w, us(r.t1));
+            if (r.thread >= TRACE_EXTERNAL_BASE)
+                threads.push_back(r.thread);
+        }
+    }
+
+    std::sort(threads.begin(), threads.end());
+    threads.erase(std::unique(threads.begin(), threads.end()), threads.end());
+    for (uint64_t it : threads)
+    {
+        std::fprintf(file, ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%llu,\"args\":{\"name\":\"thread %llu\"}}",
+                     static_cast<unsigned long long>(it), static_cast<unsigned long long>(it - TRACE_EXTERNAL_BASE));
+    }
+    std::fprintf(file, "\n]}\n");
+    return std::fclose(file) == 0;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+size_t ThreadPool::task_count(Priority prio) const
+{
+    size_t count = d->lane(prio).size();
+    if (prio == Priority::Normal)
+    {
+        for (auto& it : d->node_queue)
+        {
+            count += it->size();
+        }
+        for (auto& it : d->worker_vec)
+        {
+            count += it->local_queue.size();
+        }
+    }
+    return count;
+}
+
+bool ThreadPool::is_worker() const
+{
+    Worker* self = tls_worker;
+    return self && self->owner == d.get();
+}
+
+bool ThreadPool::run_pending_task()
+{
+    if (!is_worker())
+        return false;
+
+    Worker& self = *tls_worker;
+    Job job;
+    if (!d->pop_task(self, job))
+        return false;
+
+    d->metrics.executed(self.index);
+    if (job.task)
+    {
+        run_job(self, job);
+    }
+    return true;
+}
+
+void ThreadPool::help_step(size_t& idle)
+{
+    if (run_pending_task())
+    {
+        idle = 0;
+        return;
+    }
+
+    if (is_worker())
+    {
+        // 等待的结果完成时没有通知, 只能限时休眠; 新任务入队会提前唤醒
+        d->idle.idle_for(idle, [this]() { return d->has_task() || d->order != Order::None; }, HELP_WAIT);
+    }
+    else if (!d->idle.parks(idle))
+    {
+        // 按配置自旋或让出, ready 为 true 不会休眠
+        d->idle.idle(idle, []() { return true; });
+    }
+    else
+    {
+        // 不能占用线程池的唤醒, 否则新任务可能没有线程执行
+        std::this_thread::sleep_for(HELP_WAIT);
+    }
+}
+
+void ThreadPool::help_finish()
+{
+    // 休眠中可能占用了新任务的唤醒, 条件满足后没有取走的任务交给其他线程; 没有等待者时只是一次原子读
+    if (is_worker() && d->has_task())
+        d->idle.notify_one();
+}
+
+size_t ThreadPool::cancel_all()
+{
+    // start 与 stop 会重建 worker_vec; 在本线程池的线程中调用时线程退出前不会重建,
+    // 且不能加锁, 否则与持有锁等待本线程退出的 stop 死锁
+    std::unique_lock<std::mutex> locker(d->pool_mutex, std::defer_lock);
+    if (!is_worker())
+        locker.lock();
+
+    size_t count = 0;
+    for (auto& it : d->task_queue)
+    {
+        count += it.clear();
+    }
+
+    for (auto& it : d->node_queue)
+    {
+        count += it->clear();
+    }
+
+    Job* job = nullptr;
+    for (auto& it : d->worker_vec)
+    {
+        while (it->local_queue.steal(job))
+        {
+            delete job;
+            ++count;
+        }
+    }
+    return count;
 }
 
 void ThreadPool::clear()
 {
-    d->task_queue.clear();
+    cancel_all();
+}
+
+void ThreadPool::resize(size_t thread_count)
+{
+    std::lock_guard<std::mutex> locker(d->pool_mutex);
+    if (d->stat != Status::Running)
+        return;
+
+    thread_count = std::min(std::max<size_t>(thread_count, 1), d->worker_vec.size());
+    d->thread_size = thread_count;
+    if (!d->elastic || d->max_threads < thread_count)
+        d->max_threads = thread_count;
+
+    // 还在排队退出的线程先取消退出, 不够再创建
+    size_t active = d->active_count.load(std::memory_order_relaxed);
+    size_t retiring = d->retire_count.load(std::memory_order_relaxed);
+    for (size_t remain = active - std::min(active, retiring); remain < thread_count; remain++)
+    {
+        size_t count = d->retire_count.load(std::memory_order_relaxed);
+        while (count && !d->retire_count.compare_exchange_weak(count, count - 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+            ;
+        if (count == 0 && !d->spawn_worker(this))
+            break;
+    }
+
+    // 弹性模式下多出的线程空闲后自行退出
+    active = d->active_count.load(std::memory_order_relaxed);
+    retiring = d->retire_count.load(std::memory_order_relaxed);
+    if (!d->elastic && active > retiring + thread_count)
+    {
+        d->retire_count.fetch_add(active - retiring - thread_count, std::memory_order_acq_rel);
+        d->idle.notify_all();
+    }
+}
+
+bool ThreadPool::start(size_t thread_hint, Placement placement, const std::vector<int>& cpus)
+{
+    {
+        std::lock_guard<std::mutex> locker(d->pool_mutex);
+        if (d->stat != Status::Inited
+            && d->stat != Status::Stoped)
+            return false;
+
+        d->placement = placement;
+        d->placement_cpus = cpus;
+    }
+
+    return start(thread_hint);
 }
 
 bool ThreadPool::start(size_t thread_hint/* = 3*/)
@@ -124,11 +1219,40 @@ bool ThreadPool::start(size_t thread_hint/* = 3*/)
     d->stat = Status::Starting;
     d->order = Order::None;
     d->thread_size = usefulThreadHint(thread_hint) ? thread_hint : KERNAL_COUNT;
+    if (!d->elastic || d->max_threads < d->thread_size)
+        d->max_threads = d->thread_size;
+    d->active_count = 0;
+    d->retire_count = 0;
     d->thread_vec.clear();
+    d->worker_vec.clear();
+
+    // 工作者按上限预留, 窃取时遍历的数组在运行期间不再变化; 固定模式下为 resize 留出余量
+    const size_t capacity = std::max(d->max_threads, KERNAL_COUNT * 2);
+    std::vector<TaskQueue*> queues;
+    for (size_t i = 0; i < PRIORITY_COUNT + d->node_queue.size(); i++)
+    {
+        queues.push_back(&d->queue_at(i));
+    }
+
+    for (size_t i = 0; i < capacity; i++)
+    {
+        d->worker_vec.emplace_back(std::make_unique<Worker>(d.get(), i, &d->metrics, queues));
+        d->place_worker(*d->worker_vec.back(), i);
+    }
+    d->thread_vec.resize(capacity);
+    d->running_vec.reset(new std::atomic<Worker*>[capacity]);
+    d->running_size = 0;
+    d->metrics.start(capacity);
+#ifdef JUST_ENABLE_TRACE
+    if (d->tracing.load(std::memory_order_relaxed))
+    {
+        d->attach_trace();
+    }
+#endif
 
     for (size_t i = 0; i < d->thread_size; i++)
     {
-        d->thread_vec.emplace_back(&ThreadPool::work_func, this);
+        d->spawn_worker(this);
     }
 
     d->stat = Status::Running;
@@ -152,6 +1276,7 @@ void ThreadPool::stop(Order od)
     // d->task_queue.stop_push();
     d->stat = Status::Stopping;
     d->order = od;
+    d->idle.notify_all();
 
     for (auto& it : d->thread_vec)
     {
@@ -160,6 +1285,12 @@ void ThreadPool::stop(Order od)
     }
 
     d->thread_vec.clear();
+    d->drain_local_queues();
+    d->collect_metrics(d->history); // 工作者即将释放, 保留累计统计
+    d->history.workers.clear();
+    d->worker_vec.clear();
+    d->active_count = 0;
+    d->retire_count = 0;
     d->stat = Status::Stoped;
     d->order = Order::None;
 }
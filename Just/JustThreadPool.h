@@ -3,14 +3,50 @@
 #ifndef __JUSTTHREADPOOL_H__
 #define __JUSTTHREADPOOL_H__
 
+#include <chrono>
 #include <future>
 #include <memory>
+#include <string>
+#include <vector>
+#include <iterator>
 #include <functional>
 
+#include "JustConfig.hpp"
+#include "JustTask.hpp"
+#include "JustCancel.hpp"
+#include "JustIdle.hpp"
+#include "JustMetrics.hpp"
+#include "JustTimerWheel.hpp"
+
+#ifdef JUST_HAS_COROUTINES
+#include <coroutine>
+#endif
+
 
 namespace Just{
 
-using Task = std::function<void()>;
+namespace detail{
+
+template<typename T>
+bool future_ready(const std::future<T>& fut)
+{
+    return fut.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+template<typename T>
+bool future_ready(const std::shared_future<T>& fut)
+{
+    return fut.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+// Just::Future 等提供 is_ready 的类型
+template<typename F>
+auto future_ready(const F& fut) -> decltype(static_cast<bool>(fut.is_ready()))
+{
+    return fut.is_ready();
+}
+
+}
 
 class ThreadPool final
 {
@@ -32,36 +68,382 @@ public:
         StopAndDone,
     };
 
+    enum class Scheduler
+    {
+        Shared,        // 所有线程共享一个任务队列
+        WorkStealing,  // 每个线程一个本地队列, 空闲时从其他线程窃取
+    };
+
+    // 共享任务队列的实现, 编译时由 JUST_BLOCK_QUEUE 选择, 入队出队时没有分支
+    enum class QueueType
+    {
+        Linked,  // ConcurrentQueue, 链表
+        Block,   // ConcurrentQueue2, 按块分配, 每个提交线程一个子队列
+    };
+
+    enum class Priority
+    {
+        High,    // 延迟敏感的任务
+        Normal,  // 默认
+        Low,     // 批处理任务
+    };
+
+    static constexpr const size_t PRIORITY_COUNT = 3;
+
+    // 由 DynamicIdle 实现; 弹性模式只在休眠超时后收缩, BusySpin 与 Backoff 下线程数不会减少
+    using IdleStrategy = Just::IdleStrategy;
+
+    enum class Placement
+    {
+        None,      // 不绑定 CPU
+        Compact,   // 按节点顺序依次占满每个 CPU
+        Scatter,   // 在各节点之间轮流分配 CPU
+        CpuList,   // 按给定的 CPU 列表依次绑定
+        NumaNode,  // 线程在各节点之间轮流分配, 绑定到节点内的全部 CPU
+    };
+
+    struct Options
+    {
+        size_t thread_hint = 0;                      // 0 或超出范围时使用 CPU 核数
+        Scheduler sched = Scheduler::WorkStealing;
+        size_t aging_interval = 0;                   // 每执行多少个任务先从最低的非空优先级取一个, 0 表示严格按优先级
+
+        // 弹性模式: max_threads 大于线程数时启用, 线程数在 [thread_hint, max_threads] 之间随负载增减
+        size_t max_threads = 0;
+        size_t grow_threshold = 4;                   // 平均每个线程排队的任务数持续超过该值时增加线程
+        std::chrono::milliseconds keep_alive = std::chrono::milliseconds(1000); // 多出的线程空闲超过该时间后退出
+
+        Placement placement = Placement::None;       // 线程绑定 CPU 的方式
+        std::vector<int> cpus;                       // Placement::CpuList 使用的 CPU 编号
+
+        IdleStrategy idle = IdleStrategy::SpinPark;  // 取不到任务时的等待方式
+        size_t spin_count = 64;                      // SpinPark, Backoff: 自旋的轮数
+        size_t yield_count = 16;                     // SpinPark: 自旋之后让出的次数
+        std::chrono::microseconds backoff_min = std::chrono::microseconds(1);    // Backoff: 第一次 sleep 的时长
+        std::chrono::microseconds backoff_max = std::chrono::microseconds(1000); // Backoff: sleep 时长的上限, 即最大唤醒延迟
+    };
+
 private:
     struct Data;
     std::unique_ptr<Data> d;
 
-    void work_func();
-    void task_enqueue(Task&& t);
+    void work_func(size_t index);
+    void task_enqueue(Task&& t, Priority prio);
+    void task_enqueue_bulk(Task* tasks, size_t count);
+    void task_enqueue_node(Task&& t, size_t node);
+    bool is_worker() const;
+    void help_step(size_t& idle);
+    void help_finish();
+    TimerHandle timer_add(std::chrono::steady_clock::time_point when, Task&& t);
+    TimerHandle timer_add_every(std::chrono::steady_clock::duration period, std::function<void()>&& func);
+    static void timer_dispatch(void* ctx, Task* tasks, size_t count);
 
 public:
     ThreadPool();
     ThreadPool(size_t thread_hint);
+    ThreadPool(size_t thread_hint, Scheduler sched);
+    explicit ThreadPool(const Options& opts);
     ~ThreadPool();
 
+    /**
+     * @brief 设定的线程数, 弹性模式下为下限; 不随线程的退出与 stop 变化
+     *
+     */
     size_t thread_count() const;
+    size_t max_thread_count() const;
+
+    /**
+     * @brief 正在运行的线程数, 弹性增减与 resize 缩小时变化, stop 之后为 0
+     *
+     */
+    size_t active_thread_count() const;
+    Scheduler scheduler() const;
+    QueueType queue_type() const;
     size_t task_count() const;
+    size_t task_count(Priority prio) const;
+    size_t node_count() const;
+
+    /**
+     * @brief 各工作者统计的快照, 可以在任意线程中调用
+     *
+     */
+    PoolMetrics metrics() const;
+
+    /**
+     * @brief 开启或关闭任务时间线的记录, 需要以 JUST_ENABLE_TRACE 编译, 否则没有效果
+     *
+     * 每个任务记录入队, 开始与结束时间, 每次休眠记录休眠与唤醒时间, 写入各工作者的环形缓冲区.
+     */
+    void set_tracing(bool enable);
+
+    /**
+     * @brief 将记录的事件写为 Chrome trace-event JSON, 可以在 Perfetto 或 chrome://tracing 中打开
+     *
+     * @return 未以 JUST_ENABLE_TRACE 编译或写入失败时返回 false
+     */
+    bool dump_trace(const std::string& path) const;
 
     template<typename Func, typename... Args>
     std::future<std::result_of_t<std::decay_t<Func>(std::decay_t<Args>...)>>
         run(Func&& func, Args&&... args)
     {
         using ret_t = typename std::result_of_t<std::decay_t<Func>(std::decay_t<Args>...)>;
-        auto pkg_task = std::make_shared<std::packaged_task<ret_t(std::decay_t<Args>...)>>(std::forward<Func>(func), std::forward<Args>(args)...);
+        // packaged_task 的共享状态中同时保存了闭包, 整个 run 只有这一次分配, Task 内联保存 packaged_task
+        std::packaged_task<ret_t()> pkg_task(detail::make_invoker(std::forward<Func>(func), std::forward<Args>(args)...));
+        std::future<ret_t> fut = pkg_task.get_future();
 
-        task_enqueue([pkg_task]() { (*pkg_task)(); });
+        task_enqueue(Task(std::move(pkg_task)), Priority::Normal);
 
-        return pkg_task->get_future();
+        return fut;
     }
 
+    /**
+     * @brief 按优先级提交任务, 线程总是先取高优先级的任务
+     *
+     */
+    template<typename Func, typename... Args>
+    std::future<std::result_of_t<std::decay_t<Func>(std::decay_t<Args>...)>>
+        run(Priority prio, Func&& func, Args&&... args)
+    {
+        using ret_t = typename std::result_of_t<std::decay_t<Func>(std::decay_t<Args>...)>;
+        std::packaged_task<ret_t()> pkg_task(detail::make_invoker(std::forward<Func>(func), std::forward<Args>(args)...));
+        std::future<ret_t> fut = pkg_task.get_future();
+
+        task_enqueue(Task(std::move(pkg_task)), prio);
+
+        return fut;
+    }
+
+    /**
+     * @brief 提交可以取消的任务, 执行前 token 已被取消时跳过, future 得到 broken_promise
+     *
+     */
+    template<typename Func, typename... Args>
+    std::future<std::result_of_t<std::decay_t<Func>(std::decay_t<Args>...)>>
+        run(CancelToken token, Func&& func, Args&&... args)
+    {
+        using ret_t = typename std::result_of_t<std::decay_t<Func>(std::decay_t<Args>...)>;
+        std::packaged_task<ret_t()> pkg_task(detail::make_invoker(std::forward<Func>(func), std::forward<Args>(args)...));
+        std::future<ret_t> fut = pkg_task.get_future();
+
+        task_enqueue(Task(detail::make_cancellable(std::move(token), std::move(pkg_task))), Priority::Normal);
+
+        return fut;
+    }
+
+    /**
+     * @brief 提交任务但不创建 future, 小闭包不分配内存. 任务抛出的异常不会被捕获
+     *
+     */
+    template<typename Func, typename... Args>
+    void post(Func&& func, Args&&... args)
+    {
+        task_enqueue(Task(detail::make_invoker(std::forward<Func>(func), std::forward<Args>(args)...)), Priority::Normal);
+    }
+
+    template<typename Func, typename... Args>
+    void post(Priority prio, Func&& func, Args&&... args)
+    {
+        task_enqueue(Task(detail::make_invoker(std::forward<Func>(func), std::forward<Args>(args)...)), prio);
+    }
+
+    template<typename Func, typename... Args>
+    void post(CancelToken token, Func&& func, Args&&... args)
+    {
+        task_enqueue(Task(detail::make_cancellable(std::move(token), detail::make_invoker(std::forward<Func>(func), std::forward<Args>(args)...))), Priority::Normal);
+    }
+
+    /**
+     * @brief 提交到 NUMA 节点 node 的队列, 该节点的线程优先执行, 其他节点空闲时才会取走
+     *
+     */
+    template<typename Func, typename... Args>
+    std::future<std::result_of_t<std::decay_t<Func>(std::decay_t<Args>...)>>
+        run_on(size_t node, Func&& func, Args&&... args)
+    {
+        using ret_t = typename std::result_of_t<std::decay_t<Func>(std::decay_t<Args>...)>;
+        std::packaged_task<ret_t()> pkg_task(detail::make_invoker(std::forward<Func>(func), std::forward<Args>(args)...));
+        std::future<ret_t> fut = pkg_task.get_future();
+
+        task_enqueue_node(Task(std::move(pkg_task)), node);
+
+        return fut;
+    }
+
+    template<typename Func, typename... Args>
+    void post_on(size_t node, Func&& func, Args&&... args)
+    {
+        task_enqueue_node(Task(detail::make_invoker(std::forward<Func>(func), std::forward<Args>(args)...)), node);
+    }
+
+    /**
+     * @brief 批量提交 [first, last) 中的可调用对象, 整批只在队尾做一次 exchange
+     *
+     */
+    template<typename It>
+    void post_bulk(It first, It last)
+    {
+        std::vector<Task> tasks;
+        tasks.reserve(static_cast<size_t>(std::distance(first, last)));
+        for (; first != last; ++first)
+        {
+            tasks.emplace_back(*first);
+        }
+
+        task_enqueue_bulk(tasks.data(), tasks.size());
+    }
+
+    template<typename It>
+    std::vector<std::future<std::result_of_t<std::decay_t<typename std::iterator_traits<It>::reference>()>>>
+        run_bulk(It first, It last)
+    {
+        using ret_t = std::result_of_t<std::decay_t<typename std::iterator_traits<It>::reference>()>;
+        const size_t count = static_cast<size_t>(std::distance(first, last));
+        std::vector<Task> tasks;
+        std::vector<std::future<ret_t>> futs;
+        tasks.reserve(count);
+        futs.reserve(count);
+
+        for (; first != last; ++first)
+        {
+            std::packaged_task<ret_t()> pkg_task(*first);
+            futs.emplace_back(pkg_task.get_future());
+            tasks.emplace_back(std::move(pkg_task));
+        }
+
+        task_enqueue_bulk(tasks.data(), tasks.size());
+
+        return futs;
+    }
+
+    /**
+     * @brief 延迟 delay 后投递任务, 等待期间不占用线程. 与 post 一样不捕获异常
+     *
+     */
+    template<typename Rep, typename Period, typename Func, typename... Args>
+    TimerHandle run_after(const std::chrono::duration<Rep, Period>& delay, Func&& func, Args&&... args)
+    {
+        return timer_add(std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(delay),
+                         Task(detail::make_invoker(std::forward<Func>(func), std::forward<Args>(args)...)));
+    }
+
+    template<typename Clock, typename Duration, typename Func, typename... Args>
+    TimerHandle run_at(const std::chrono::time_point<Clock, Duration>& when, Func&& func, Args&&... args)
+    {
+        // 其他时钟的时间点换算为 steady_clock, 之后调整系统时间不影响
+        return run_after(when - Clock::now(), std::forward<Func>(func), std::forward<Args>(args)...);
+    }
+
+    /**
+     * @brief 每隔 period 投递一次 func, 直到通过句柄取消. 上一次尚未执行完时不会跳过
+     *
+     */
+    template<typename Rep, typename Period, typename Func>
+    TimerHandle run_every(const std::chrono::duration<Rep, Period>& period, Func&& func)
+    {
+        return timer_add_every(std::chrono::duration_cast<std::chrono::steady_clock::duration>(period),
+                               std::function<void()>(std::forward<Func>(func)));
+    }
+
+#ifdef JUST_HAS_COROUTINES
+    class ScheduleAwaiter
+    {
+        ThreadPool& _pool;
+        Priority _prio;
+
+    public:
+        ScheduleAwaiter(ThreadPool& pool, Priority prio) noexcept
+            : _pool(pool)
+            , _prio(prio)
+        {}
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            // 只捕获协程句柄, Task 内联保存, 不分配内存
+            _pool.task_enqueue(Task([handle]() { handle.resume(); }), _prio);
+        }
+
+        void await_resume() const noexcept
+        {}
+    };
+
+    /**
+     * @brief co_await pool.schedule() 挂起当前协程, 之后在线程池的线程中恢复
+     *
+     */
+    ScheduleAwaiter schedule(Priority prio = Priority::Normal) noexcept
+    {
+        return ScheduleAwaiter(*this, prio);
+    }
+#endif
+
+    /**
+     * @brief 当前线程是本线程池的线程时, 取出一个排队中的任务并执行
+     *
+     * @return false 不是本线程池的线程或没有任务
+     */
+    bool run_pending_task();
+
+    /**
+     * @brief pred 返回 true 期间, 本线程池的线程继续执行其他排队中的任务, 没有任务时短暂休眠后再检查 pred
+     *
+     * 其他线程只是等待. 用于在任务中等待同一线程池中的子任务, 避免所有线程都阻塞导致死锁.
+     */
+    template<typename Pred>
+    void help_while(Pred&& pred)
+    {
+        size_t idle = 0;
+        while (pred())
+        {
+            help_step(idle);
+        }
+        help_finish();
+    }
+
+    /**
+     * @brief 等待 fut 就绪, 在本线程池的线程中调用时等待期间执行其他任务, 之后再 get 不会阻塞
+     *
+     * 支持 std::future, std::shared_future 以及 Just::Future.
+     */
+    template<typename Future>
+    void wait(const Future& fut)
+    {
+        if (!is_worker())
+        {
+            fut.wait();
+            return;
+        }
+        help_while([&fut]() { return !detail::future_ready(fut); });
+    }
+
+    /**
+     * @brief 析构所有排队中的任务并回收队列节点, 被丢弃的 run 任务的 future 得到 broken_promise
+     *
+     * 排队中的任务包括各线程本地队列中的任务; 不影响正在执行的任务与尚未到期的定时任务.
+     * 与 push 并发时, 调用之后入队的任务保留.
+     * @return size_t 丢弃的任务数
+     */
+    size_t cancel_all();
+
+    /**
+     * @brief 等同于 cancel_all
+     *
+     */
     void clear();
 
+    /**
+     * @brief 不停止线程池调整线程数, 多出的线程执行完当前任务后退出. 弹性模式下调整的是下限
+     *
+     */
+    void resize(size_t thread_count);
+
     bool start(size_t thread_hint = 3);
+    bool start(size_t thread_hint, Placement placement, const std::vector<int>& cpus = std::vector<int>());
     Status status() const;
     void stop(Order od = Order::StopAndDone);
 };
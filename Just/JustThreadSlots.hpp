@@ -0,0 +1,128 @@
+
+#ifndef __JUSTTHREADSLOTS_H__
+#define __JUSTTHREADSLOTS_H__
+
+#include <cstdint>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <unordered_set>
+
+
+namespace Just{
+
+namespace detail{
+
+/**
+ * @brief 线程私有槽位: 某个线程在某个容器 (以 owner_id 标识) 中占用的对象
+ *
+ * 线程退出时只归还仍然存活的容器中的槽位, owner_id 全局唯一且不复用.
+ * 容器析构后, 各线程在下次添加槽位时丢弃属于它的条目, 缓存只包含仍然存活的容器.
+ */
+struct ThreadSlot
+{
+    uint64_t owner_id;
+    void* slot;
+    void (*release)(void* slot);
+};
+
+inline std::mutex& thread_slot_registry_mutex()
+{
+    static std::mutex registry_mutex;
+    return registry_mutex;
+}
+
+inline std::unordered_set<uint64_t>& thread_slot_registry()
+{
+    static std::unordered_set<uint64_t> alive_owners;
+    return alive_owners;
+}
+
+// 每析构一个容器加一, 线程据此判断缓存中是否可能有失效的条目
+inline std::atomic<uint64_t>& thread_slot_generation()
+{
+    static std::atomic<uint64_t> generation { 0 };
+    return generation;
+}
+
+inline uint64_t register_slot_owner()
+{
+    static std::atomic<uint64_t> owner_id { 1 };
+    uint64_t id = owner_id.fetch_add(1, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> locker(thread_slot_registry_mutex());
+    thread_slot_registry().insert(id);
+    return id;
+}
+
+inline void unregister_slot_owner(uint64_t id)
+{
+    std::lock_guard<std::mutex> locker(thread_slot_registry_mutex());
+    thread_slot_registry().erase(id);
+    thread_slot_generation().fetch_add(1, std::memory_order_release);
+}
+
+struct ThreadSlotCache
+{
+    std::vector<ThreadSlot> slots;
+    uint64_t generation = 0; // 上次清理时的 thread_slot_generation
+
+    ~ThreadSlotCache()
+    {
+        std::lock_guard<std::mutex> locker(thread_slot_registry_mutex());
+        for (auto& it : slots)
+        {
+            if (thread_slot_registry().count(it.owner_id))
+                it.release(it.slot);
+        }
+    }
+
+    /**
+     * @brief 查找 owner_id 的槽位, 找到后移到最前面, 经常使用的容器只比较一次
+     *
+     */
+    void* find(uint64_t owner_id) noexcept
+    {
+        for (size_t i = 0; i < slots.size(); i++)
+        {
+            if (slots[i].owner_id == owner_id)
+            {
+                if (i > 0)
+                    std::swap(slots[i], slots[0]);
+                return slots[0].slot;
+            }
+        }
+        return nullptr;
+    }
+
+    void add(uint64_t owner_id, void* slot, void (*release)(void* slot))
+    {
+        uint64_t current = thread_slot_generation().load(std::memory_order_acquire);
+        if (current != generation)
+        {
+            // 有容器析构过, 丢弃已失效的条目; 槽位已随容器释放, 不再调用 release
+            std::lock_guard<std::mutex> locker(thread_slot_registry_mutex());
+            auto& alive = thread_slot_registry();
+            slots.erase(std::remove_if(slots.begin(), slots.end(), [&alive](const ThreadSlot& it) {
+                return alive.count(it.owner_id) == 0;
+            }), slots.end());
+            generation = current;
+        }
+
+        slots.push_back({ owner_id, slot, release });
+    }
+};
+
+inline ThreadSlotCache& thread_slot_cache()
+{
+    thread_local ThreadSlotCache cache;
+    return cache;
+}
+
+}
+
+}
+
+#endif // __JUSTTHREADSLOTS_H__
@@ -0,0 +1,392 @@
+
+#ifndef __JUSTTIMERWHEEL_H__
+#define __JUSTTIMERWHEEL_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+
+#include "JustTask.hpp"
+
+
+namespace Just{
+
+class TimerWheel;
+
+/**
+ * @brief 定时任务的句柄, 用于取消; 所属的线程池析构后不可再使用
+ *
+ */
+class TimerHandle final
+{
+    private:
+        TimerWheel* _wheel;
+        void* _timer;
+        uint64_t _id;
+
+    public:
+        TimerHandle() noexcept
+            : _wheel { nullptr }
+            , _timer { nullptr }
+            , _id { 0 }
+        {}
+
+        TimerHandle(TimerWheel* wheel, void* timer, uint64_t id) noexcept
+            : _wheel { wheel }
+            , _timer { timer }
+            , _id { id }
+        {}
+
+        /**
+         * @brief 取消尚未到期的定时任务, 周期任务取消后不再触发
+         *
+         * @return true 取消成功, false 已经触发过 (单次任务) 或已经取消
+         */
+        bool cancel();
+
+        explicit operator bool() const noexcept
+        {
+            return _wheel != nullptr;
+        }
+};
+
+/**
+ * @brief 分层时间轮, 由一个定时线程驱动
+ *
+ * 以毫秒为一个刻度, 4 层每层 256 个槽, 覆盖约 49 天, 更远的定时器在最高层轮转.
+ * 添加与取消都是 O(1); 到期的任务整批交给 Dispatch 回调放入任务队列.
+ * 定时线程在第一次添加定时器时才创建, 没有定时器时一直休眠.
+ */
+class TimerWheel final
+{
+    public:
+        using Clock = std::chrono::steady_clock;
+        using Tick = std::chrono::milliseconds;
+        using Dispatch = void (*)(void* ctx, Task* tasks, size_t count);
+
+        static constexpr const size_t WHEEL_BITS = 8;
+        static constexpr const size_t WHEEL_SIZE = size_t(1) << WHEEL_BITS;
+        static constexpr const size_t WHEEL_MASK = WHEEL_SIZE - 1;
+        static constexpr const size_t WHEEL_LEVELS = 4;
+
+    private:
+        struct Timer
+        {
+            Task task;                                  // 单次任务
+            std::shared_ptr<std::function<void()>> periodic; // 周期任务, 每次触发投递一个引用它的 Task
+            uint64_t expire;                            // 到期刻度
+            uint64_t period;                            // 周期刻度数, 0 表示单次
+            bool inline_call;                           // 周期任务直接在定时线程中执行, 不投递
+            uint64_t id;                                // 每次复用递增, 用于判断句柄是否过期
+            Timer* prev;
+            Timer* next;
+            Timer** head;                               // 所在槽的链表头
+        };
+
+        std::mutex _mutex;
+        std::condition_variable _cond;
+        std::thread _thread;
+        bool _quit;
+
+        Timer* _slots[WHEEL_LEVELS][WHEEL_SIZE];
+        std::vector<std::unique_ptr<Timer>> _nodes; // 所有分配过的定时器, 只在析构时释放
+        Timer* _free;
+        size_t _count;                              // 未触发的定时器数量
+        uint64_t _current;                          // 下一个要处理的刻度
+        uint64_t _wake_tick;                        // 定时线程计划醒来的刻度
+        uint64_t _next_id;
+        const Clock::time_point _origin;
+
+        Dispatch _dispatch;
+        void* _ctx;
+
+        uint64_t now_tick() const
+        {
+            return static_cast<uint64_t>(std::chrono::duration_cast<Tick>(Clock::now() - _origin).count());
+        }
+
+        uint64_t to_tick(Clock::time_point when) const
+        {
+            if (when <= _origin)
+                return 0;
+            // 向上取整, 不会提前触发
+            Clock::duration d = when - _origin + Tick(1) - Clock::duration(1);
+            return static_cast<uint64_t>(std::chrono::duration_cast<Tick>(d).count());
+        }
+
+        Timer* alloc_timer()
+        {
+            Timer* timer = _free;
+            if (timer) {
+                _free = timer->next;
+            }
+            else {
+                _nodes.emplace_back(new Timer());
+                timer = _nodes.back().get();
+            }
+            timer->id = ++_next_id;
+            timer->prev = nullptr;
+            timer->next = nullptr;
+            timer->head = nullptr;
+            ++_count;
+            return timer;
+        }
+
+        void free_timer(Timer* timer)
+        {
+            timer->task = nullptr;
+            timer->periodic.reset();
+            timer->id = ++_next_id;
+            timer->head = nullptr;
+            timer->next = _free;
+            _free = timer;
+            --_count;
+        }
+
+        void link(Timer* timer)
+        {
+            uint64_t expire = timer->expire > _current ? timer->expire : _current;
+            uint64_t delta = expire - _current;
+            size_t level = 0;
+            while (level + 1 < WHEEL_LEVELS && delta >= (uint64_t(1) << (WHEEL_BITS * (level + 1))))
+                ++level;
+
+            const uint64_t span = uint64_t(1) << (WHEEL_BITS * WHEEL_LEVELS);
+            if (delta >= span)
+                expire = _current + span - 1; // 超出范围, 先放在最高层, 级联时重新计算
+
+            Timer** head = &_slots[level][(expire >> (WHEEL_BITS * level)) & WHEEL_MASK];
+            timer->head = head;
+            timer->prev = nullptr;
+            timer->next = *head;
+            if (*head)
+                (*head)->prev = timer;
+            *head = timer;
+        }
+
+        void unlink(Timer* timer)
+        {
+            if (timer->prev)
+                timer->prev->next = timer->next;
+            else
+                *timer->head = timer->next;
+            if (timer->next)
+                timer->next->prev = timer->prev;
+            timer->head = nullptr;
+        }
+
+        void cascade(size_t level, size_t index)
+        {
+            Timer* timer = _slots[level][index];
+            _slots[level][index] = nullptr;
+            while (timer)
+            {
+                Timer* next = timer->next;
+                link(timer);
+                timer = next;
+            }
+        }
+
+        void fire(Timer* timer, std::vector<Task>& expired, std::vector<std::shared_ptr<std::function<void()>>>& calls)
+        {
+            if (timer->period == 0) {
+                expired.push_back(std::move(timer->task));
+                free_timer(timer);
+                return;
+            }
+
+            std::shared_ptr<std::function<void()>> func = timer->periodic;
+            if (timer->inline_call)
+                calls.push_back(func);
+            else
+                expired.emplace_back([func]() { (*func)(); });
+            // 固定频率; 落后时不补发, 从下一个刻度继续
+            timer->expire += timer->period;
+            if (timer->expire <= _current)
+                timer->expire = _current + 1;
+            link(timer);
+        }
+
+        void advance(uint64_t now, std::vector<Task>& expired, std::vector<std::shared_ptr<std::function<void()>>>& calls)
+        {
+            while (_count && _current <= now)
+            {
+                size_t index = _current & WHEEL_MASK;
+                if (index == 0) {
+                    for (size_t level = 1; level < WHEEL_LEVELS; level++)
+                    {
+                        size_t upper = (_current >> (WHEEL_BITS * level)) & WHEEL_MASK;
+                        cascade(level, upper);
+                        if (upper != 0)
+                            break;
+                    }
+                }
+
+                Timer* timer = _slots[0][index];
+                _slots[0][index] = nullptr;
+                while (timer)
+                {
+                    Timer* next = timer->next;
+                    fire(timer, expired, calls);
+                    timer = next;
+                }
+                ++_current;
+            }
+
+            // 没有定时器时直接跳过空闲的刻度
+            if (_count == 0 && _current <= now)
+                _current = now + 1;
+        }
+
+        uint64_t next_tick() const
+        {
+            // 最低层到下一次级联之间的第一个非空槽, 都为空时在级联处醒来
+            size_t index = _current & WHEEL_MASK;
+            for (size_t i = index; i < WHEEL_SIZE; i++)
+            {
+                if (_slots[0][i])
+                    return _current + (i - index);
+            }
+            return _current + (WHEEL_SIZE - index);
+        }
+
+        void run_loop()
+        {
+            std::vector<Task> expired;
+            std::vector<std::shared_ptr<std::function<void()>>> calls;
+            std::unique_lock<std::mutex> locker(_mutex);
+            while (!_quit)
+            {
+                advance(now_tick(), expired, calls);
+                if (!expired.empty() || !calls.empty()) {
+                    locker.unlock();
+                    if (!expired.empty())
+                        _dispatch(_ctx, expired.data(), expired.size());
+                    for (auto& it : calls)
+                        (*it)();
+                    expired.clear();
+                    calls.clear();
+                    locker.lock();
+                    continue;
+                }
+
+                if (_count == 0) {
+                    _wake_tick = UINT64_MAX;
+                    _cond.wait(locker);
+                }
+                else {
+                    _wake_tick = next_tick();
+                    _cond.wait_until(locker, _origin + Tick(_wake_tick));
+                }
+            }
+        }
+
+        TimerHandle add(Timer* timer, uint64_t expire)
+        {
+            timer->expire = expire;
+            link(timer);
+
+            if (!_thread.joinable())
+                _thread = std::thread(&TimerWheel::run_loop, this);
+            if (expire < _wake_tick)
+                _cond.notify_one();
+
+            return TimerHandle(this, timer, timer->id);
+        }
+
+    public:
+        TimerWheel(Dispatch dispatch, void* ctx)
+            : _quit { false }
+            , _slots {}
+            , _free { nullptr }
+            , _count { 0 }
+            , _current { 0 }
+            , _wake_tick { UINT64_MAX }
+            , _next_id { 0 }
+            , _origin { Clock::now() }
+            , _dispatch { dispatch }
+            , _ctx { ctx }
+        {}
+
+        /**
+         * @brief 停止定时线程, 未触发的定时任务直接丢弃
+         *
+         */
+        ~TimerWheel()
+        {
+            {
+                std::lock_guard<std::mutex> locker(_mutex);
+                _quit = true;
+            }
+            _cond.notify_one();
+            if (_thread.joinable())
+                _thread.join();
+        }
+
+        TimerWheel(TimerWheel&&) = delete;
+        TimerWheel(const TimerWheel&) = delete;
+        TimerWheel& operator=(TimerWheel&&) = delete;
+        TimerWheel& operator=(const TimerWheel&) = delete;
+
+        TimerHandle add_at(Clock::time_point when, Task&& task)
+        {
+            std::lock_guard<std::mutex> locker(_mutex);
+            Timer* timer = alloc_timer();
+            timer->task = std::move(task);
+            timer->period = 0;
+            timer->inline_call = false;
+            return add(timer, to_tick(when));
+        }
+
+        /**
+         * @brief 周期任务; inline_call 为 true 时直接在定时线程中执行, 只用于很短的内部检查
+         *
+         */
+        TimerHandle add_every(Clock::duration period, std::function<void()>&& func, bool inline_call = false)
+        {
+            uint64_t ticks = static_cast<uint64_t>(std::chrono::duration_cast<Tick>(period + Tick(1) - Clock::duration(1)).count());
+            std::lock_guard<std::mutex> locker(_mutex);
+            Timer* timer = alloc_timer();
+            timer->periodic = std::make_shared<std::function<void()>>(std::move(func));
+            timer->period = ticks ? ticks : 1;
+            timer->inline_call = inline_call;
+            return add(timer, to_tick(Clock::now()) + timer->period);
+        }
+
+        bool cancel(void* ptr, uint64_t id)
+        {
+            Task task;
+            std::lock_guard<std::mutex> locker(_mutex);
+            Timer* timer = static_cast<Timer*>(ptr);
+            if (timer->id != id)
+                return false;
+
+            unlink(timer);
+            task = std::move(timer->task); // 在锁外析构任务
+            free_timer(timer);
+            return true;
+        }
+
+        size_t size()
+        {
+            std::lock_guard<std::mutex> locker(_mutex);
+            return _count;
+        }
+};
+
+inline bool TimerHandle::cancel()
+{
+    if (!_wheel)
+        return false;
+    return _wheel->cancel(_timer, _id);
+}
+
+}
+
+#endif // __JUSTTIMERWHEEL_H__
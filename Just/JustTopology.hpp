@@ -0,0 +1,183 @@
+
+#ifndef __JUSTTOPOLOGY_H__
+#define __JUSTTOPOLOGY_H__
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+namespace Just{
+
+/**
+ * @brief CPU 拓扑: 每个 NUMA 节点上当前进程允许使用的 CPU
+ *
+ * Linux 下读取 /sys/devices/system/node, 并与 sched_getaffinity 的结果取交集;
+ * 其他平台或读取失败时视为只有一个节点.
+ */
+struct CpuTopology
+{
+    std::vector<std::vector<int>> nodes; // nodes[i] 为节点 i 的 CPU 编号, 不含空节点
+
+    size_t cpu_count() const noexcept
+    {
+        size_t count = 0;
+        for (auto& it : nodes)
+            count += it.size();
+        return count;
+    }
+
+    /**
+     * @brief cpu 所在节点的下标, 不在任何节点中时返回 0
+     *
+     */
+    size_t node_of(int cpu) const noexcept
+    {
+        for (size_t i = 0; i < nodes.size(); i++)
+        {
+            if (std::find(nodes[i].begin(), nodes[i].end(), cpu) != nodes[i].end())
+                return i;
+        }
+        return 0;
+    }
+};
+
+namespace detail{
+
+/**
+ * @brief 解析 "0-3,8,10-11" 形式的 CPU 列表
+ *
+ */
+inline std::vector<int> parse_cpu_list(const std::string& text)
+{
+    std::vector<int> cpus;
+    size_t pos = 0;
+    while (pos < text.size())
+    {
+        size_t end = text.find(',', pos);
+        if (end == std::string::npos)
+            end = text.size();
+
+        int first = -1;
+        int last = -1;
+        std::string item = text.substr(pos, end - pos);
+        int n = std::sscanf(item.c_str(), "%d-%d", &first, &last);
+        if (n == 1)
+            last = first;
+        if (n >= 1 && first >= 0 && last >= first)
+        {
+            for (int cpu = first; cpu <= last; cpu++)
+                cpus.push_back(cpu);
+        }
+        pos = end + 1;
+    }
+    return cpus;
+}
+
+inline bool read_line(const char* path, std::string& line)
+{
+    FILE* file = std::fopen(path, "r");
+    if (!file)
+        return false;
+
+    char buffer[4096] = { 0 };
+    bool ok = std::fgets(buffer, sizeof(buffer), file) != nullptr;
+    std::fclose(file);
+    line = buffer;
+    return ok;
+}
+
+inline std::vector<int> allowed_cpus()
+{
+    std::vector<int> cpus;
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        {
+            if (CPU_ISSET(cpu, &set))
+                cpus.push_back(cpu);
+        }
+    }
+#endif
+    if (cpus.empty())
+    {
+        unsigned count = std::thread::hardware_concurrency();
+        for (unsigned cpu = 0; cpu < (count ? count : 1); cpu++)
+            cpus.push_back(static_cast<int>(cpu));
+    }
+    return cpus;
+}
+
+}
+
+inline CpuTopology detect_topology()
+{
+    CpuTopology topo;
+    std::vector<int> allowed = detail::allowed_cpus();
+
+#if defined(__linux__)
+    std::string line;
+    if (detail::read_line("/sys/devices/system/node/online", line))
+    {
+        char path[128] = { 0 };
+        for (int node : detail::parse_cpu_list(line))
+        {
+            std::snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+            if (!detail::read_line(path, line))
+                continue;
+
+            std::vector<int> cpus;
+            for (int cpu : detail::parse_cpu_list(line))
+            {
+                if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end())
+                    cpus.push_back(cpu);
+            }
+            if (!cpus.empty())
+                topo.nodes.push_back(std::move(cpus));
+        }
+    }
+#endif
+
+    if (topo.nodes.empty())
+        topo.nodes.push_back(std::move(allowed));
+
+    return topo;
+}
+
+/**
+ * @brief 将当前线程绑定到 cpus, 不支持的平台返回 false
+ *
+ */
+inline bool pin_current_thread(const std::vector<int>& cpus)
+{
+#if defined(__linux__)
+    if (cpus.empty())
+        return false;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+    {
+        if (cpu >= 0 && cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+}
+
+#endif // __JUSTTOPOLOGY_H__
@@ -0,0 +1,183 @@
+
+#ifndef __JUSTTRACE_H__
+#define __JUSTTRACE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <algorithm>
+
+#include "JustConfig.hpp"
+
+#if !defined(_MSC_VER) && (defined(__i386__) || defined(__x86_64__))
+#include <x86intrin.h>
+#endif
+
+
+namespace Just{
+
+/**
+ * @brief 追踪用的时间戳, x86 上为 TSC, 由 TraceClock 换算为纳秒; 其他平台直接是纳秒
+ *
+ */
+inline uint64_t trace_now() noexcept
+{
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+    return __rdtsc();
+#elif defined(__i386__) || defined(__x86_64__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+/**
+ * @brief 记录开始时的 trace_now 与 steady_clock, 导出时再取一次, 按比例换算为纳秒
+ *
+ */
+class TraceClock final
+{
+    private:
+        uint64_t _tick0;
+        std::chrono::steady_clock::time_point _time0;
+
+    public:
+        TraceClock() noexcept
+        {
+            reset();
+        }
+
+        void reset() noexcept
+        {
+            _tick0 = trace_now();
+            _time0 = std::chrono::steady_clock::now();
+        }
+
+        uint64_t origin() const noexcept
+        {
+            return _tick0;
+        }
+
+        /**
+         * @brief 每个 tick 的纳秒数
+         *
+         */
+        double ns_per_tick() const noexcept
+        {
+            uint64_t ticks = trace_now() - _tick0;
+            double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - _time0).count());
+            return ticks ? ns / static_cast<double>(ticks) : 1.0;
+        }
+};
+
+struct TraceRecord
+{
+    enum class Kind : uint64_t
+    {
+        Task,    // id, 提交线程, 入队, 开始, 结束
+        Park,    // 休眠, 被唤醒
+    };
+
+    Kind kind;
+    uint64_t id;
+    uint64_t thread;   // Task: 提交线程的编号
+    uint64_t t0;
+    uint64_t t1;
+    uint64_t t2;
+};
+
+/**
+ * @brief 单写者的环形事件缓冲区, 写满后覆盖最旧的事件
+ *
+ * 只有所属工作者的线程写入; 导出线程随时读取, 与 seqlock 相同, 写入前先递增 _reserve,
+ * 读完后根据 _reserve 丢弃读取期间可能被覆盖的事件. 字段都是 relaxed 原子变量, 写入一个事件只有几次普通的 store.
+ */
+class TraceRing final
+{
+    private:
+        struct Slot
+        {
+            std::atomic<uint64_t> kind;
+            std::atomic<uint64_t> id;
+            std::atomic<uint64_t> thread;
+            std::atomic<uint64_t> t0;
+            std::atomic<uint64_t> t1;
+            std::atomic<uint64_t> t2;
+        };
+
+        std::unique_ptr<Slot[]> _slots;
+        const size_t _mask;
+        std::atomic<uint64_t> _reserve; // 开始写入的事件总数
+        std::atomic<uint64_t> _head;    // 写入完成的事件总数
+
+    public:
+        explicit TraceRing(size_t capacity)
+            : _slots { new Slot[capacity] }
+            , _mask { capacity - 1 }
+            , _reserve { 0 }
+            , _head { 0 }
+        {
+            // capacity 为 2 的幂
+        }
+
+        TraceRing(const TraceRing&) = delete;
+        TraceRing& operator=(const TraceRing&) = delete;
+
+        void push(TraceRecord::Kind kind, uint64_t id, uint64_t thread, uint64_t t0, uint64_t t1, uint64_t t2) noexcept
+        {
+            uint64_t head = _head.load(std::memory_order_relaxed);
+            _reserve.store(head + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            Slot& slot = _slots[head & _mask];
+            slot.kind.store(static_cast<uint64_t>(kind), std::memory_order_relaxed);
+            slot.id.store(id, std::memory_order_relaxed);
+            slot.thread.store(thread, std::memory_order_relaxed);
+            slot.t0.store(t0, std::memory_order_relaxed);
+            slot.t1.store(t1, std::memory_order_relaxed);
+            slot.t2.store(t2, std::memory_order_relaxed);
+            _head.store(head + 1, std::memory_order_release);
+        }
+
+        /**
+         * @brief 复制当前仍然有效的事件, 按写入顺序追加到 out
+         *
+         */
+        void snapshot(std::vector<TraceRecord>& out) const
+        {
+            const uint64_t capacity = _mask + 1;
+            uint64_t head = _head.load(std::memory_order_acquire);
+            uint64_t first = head > capacity ? head - capacity : 0;
+            size_t base = out.size();
+
+            for (uint64_t i = first; i < head; i++)
+            {
+                const Slot& slot = _slots[i & _mask];
+                TraceRecord r;
+                r.kind = static_cast<TraceRecord::Kind>(slot.kind.load(std::memory_order_relaxed));
+                r.id = slot.id.load(std::memory_order_relaxed);
+                r.thread = slot.thread.load(std::memory_order_relaxed);
+                r.t0 = slot.t0.load(std::memory_order_relaxed);
+                r.t1 = slot.t1.load(std::memory_order_relaxed);
+                r.t2 = slot.t2.load(std::memory_order_relaxed);
+                out.push_back(r);
+            }
+
+            // 读取期间写入者可能已经绕回, 丢弃可能被覆盖的部分
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t reserve = _reserve.load(std::memory_order_relaxed);
+            uint64_t valid = reserve > capacity ? reserve - capacity : 0;
+            if (valid > first) {
+                size_t drop = static_cast<size_t>(std::min<uint64_t>(valid - first, head - first));
+                out.erase(out.begin() + static_cast<std::ptrdiff_t>(base), out.begin() + static_cast<std::ptrdiff_t>(base + drop));
+            }
+        }
+};
+
+}
+
+#endif // __JUSTTRACE_H__
@@ -0,0 +1,179 @@
+
+#ifndef __JUSTWORKSTEALINGDEQUE_H__
+#define __JUSTWORKSTEALINGDEQUE_H__
+
+#include <cstdint>
+#include <atomic>
+#include <vector>
+#include <type_traits>
+
+#include "JustConfig.hpp"
+
+
+namespace Just{
+
+/**
+ * @brief Chase-Lev 工作窃取双端队列
+ *
+ * 只有拥有者线程可以 push/pop (LIFO, 尾部), 其他线程通过 steal 从头部窃取 (FIFO).
+ * 元素以原子方式存放, 因此 T 需要是可平凡复制的类型, 一般为指针.
+ */
+template<typename T>
+class WorkStealingDeque final
+{
+    static_assert(std::is_trivially_copyable<T>::value, "WorkStealingDeque<T> requires trivially copyable T");
+
+    private:
+        struct Array
+        {
+            int64_t _capacity;
+            int64_t _mask;
+            std::atomic<T>* _buffer;
+
+            explicit Array(int64_t capacity)
+                : _capacity { capacity }
+                , _mask { capacity - 1 }
+                , _buffer { new std::atomic<T>[static_cast<size_t>(capacity)] }
+            {}
+
+            ~Array()
+            {
+                delete[] _buffer;
+            }
+
+            T get(int64_t i) const noexcept
+            {
+                return _buffer[i & _mask].load(std::memory_order_relaxed);
+            }
+
+            void put(int64_t i, T v) noexcept
+            {
+                _buffer[i & _mask].store(v, std::memory_order_relaxed);
+            }
+
+            Array* grow(int64_t bottom, int64_t top) const
+            {
+                Array* array = new Array(_capacity * 2);
+                for (int64_t i = top; i != bottom; ++i)
+                    array->put(i, get(i));
+                return array;
+            }
+        };
+
+        std::atomic<int64_t> _top;
+        char _pad0[CACHE_LINE_SIZE - sizeof(std::atomic<int64_t>)];
+        std::atomic<int64_t> _bottom;
+        char _pad1[CACHE_LINE_SIZE - sizeof(std::atomic<int64_t>)];
+        std::atomic<Array*> _array;
+        std::vector<Array*> _garbage; // 扩容后的旧数组, 窃取者可能仍在读取, 析构时统一释放
+
+    public:
+        explicit WorkStealingDeque(int64_t capacity = 256)
+            : _top { 0 }
+            , _bottom { 0 }
+            , _array { nullptr }
+        {
+            int64_t cap = 1;
+            while (cap < capacity)
+                cap <<= 1;
+            _array.store(new Array(cap), std::memory_order_relaxed);
+        }
+
+        ~WorkStealingDeque()
+        {
+            for (Array* array : _garbage)
+                delete array;
+            delete _array.load(std::memory_order_relaxed);
+        }
+
+        WorkStealingDeque(WorkStealingDeque&&) = delete;
+        WorkStealingDeque(const WorkStealingDeque&) = delete;
+        WorkStealingDeque& operator=(WorkStealingDeque&&) = delete;
+        WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+        /**
+         * @brief 仅拥有者线程调用
+         *
+         */
+        void push(T v)
+        {
+            int64_t bottom = _bottom.load(std::memory_order_relaxed);
+            int64_t top = _top.load(std::memory_order_acquire);
+            Array* array = _array.load(std::memory_order_relaxed);
+
+            if (bottom - top > array->_capacity - 1) {
+                Array* bigger = array->grow(bottom, top);
+                _garbage.push_back(array);
+                array = bigger;
+                _array.store(array, std::memory_order_release);
+            }
+
+            // 窃取者以 acquire 读取 _bottom 后才能看到元素及其指向的对象
+            array->put(bottom, v);
+            _bottom.store(bottom + 1, std::memory_order_release);
+        }
+
+        /**
+         * @brief 仅拥有者线程调用
+         *
+         */
+        bool pop(T& v)
+        {
+            int64_t bottom = _bottom.load(std::memory_order_relaxed) - 1;
+            Array* array = _array.load(std::memory_order_relaxed);
+            _bottom.store(bottom, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t top = _top.load(std::memory_order_relaxed);
+
+            // 恢复 _bottom 同样用 release, 读到该值的窃取者仍与之前的 push 同步
+            if (top > bottom) {
+                _bottom.store(bottom + 1, std::memory_order_release);
+                return false;
+            }
+
+            v = array->get(bottom);
+            if (top == bottom) {
+                // 最后一个元素, 与窃取者竞争
+                bool won = _top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+                _bottom.store(bottom + 1, std::memory_order_release);
+                return won;
+            }
+
+            return true;
+        }
+
+        /**
+         * @brief 任意线程调用
+         *
+         */
+        bool steal(T& v)
+        {
+            int64_t top = _top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t bottom = _bottom.load(std::memory_order_acquire);
+
+            if (top >= bottom)
+                return false;
+
+            Array* array = _array.load(std::memory_order_acquire);
+            v = array->get(top);
+
+            return _top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        }
+
+        bool empty() const noexcept
+        {
+            return size() <= 0;
+        }
+
+        int64_t size() const noexcept
+        {
+            int64_t bottom = _bottom.load(std::memory_order_relaxed);
+            int64_t top = _top.load(std::memory_order_relaxed);
+            return bottom > top ? bottom - top : 0;
+        }
+};
+
+}
+
+#endif // __JUSTWORKSTEALINGDEQUE_H__
@@ -0,0 +1,667 @@
+
+#include "Just/JustConcurrentQueue.hpp"
+#include "Just/JustCQ.hpp"
+#include "Just/JustBoundedQueue.hpp"
+#include "Just/JustSpscQueue.hpp"
+
+#ifdef JUST_BENCH_MOODYCAMEL
+#include <concurrentqueue/concurrentqueue.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <array>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+/**
+ * 队列基准测试
+ *
+ * 对每个队列按 生产者数 x 消费者数 x 负载大小 x 突发模式 扫描, 每个组合先预热一次再重复 repeat 次,
+ * 每次输出一行: 吞吐量, push / pop / 端到端延迟的分位数, 可选的 cycles 与 cache-misses 计数.
+ * 结果为 CSV 或 JSON, 用 --label 标记提交, 便于跨提交比较.
+ *
+ *   bench --producers 1,4 --consumers 1,4 --payload 8,64 --burst 0,64 --format csv --label $(git rev-parse --short HEAD)
+ */
+
+namespace
+{
+    const size_t SAMPLE_INTERVAL = 64;   // 每隔多少次操作采样一次延迟, 避免读时钟主导测量
+    const size_t SPIN_BEFORE_YIELD = 64; // 连续失败多少次后让出 CPU
+
+    struct Config
+    {
+        vector<string> queues { "linked", "block", "bounded", "spsc", "moodycamel" };
+        vector<size_t> producers { 1, 4 };
+        vector<size_t> consumers { 1, 4 };
+        vector<size_t> payloads { 8, 64, 256 };
+        vector<size_t> bursts { 0, 64 };   // 0 为持续写入, 否则每写入 burst 个停顿 burst_gap_us
+        size_t burst_gap_us = 20;
+        size_t ops = 1000000;
+        size_t warmup = 100000;
+        size_t repeat = 3;
+        size_t capacity = 1 << 16;         // 有界队列的容量
+        bool perf = false;
+        string format = "csv";
+        string out;
+        string label;
+    };
+
+    struct Result
+    {
+        string queue;
+        size_t producers;
+        size_t consumers;
+        size_t payload;
+        size_t burst;
+        size_t repeat;
+        size_t ops;
+        double seconds;
+        double ops_per_sec;
+        uint64_t push_ns[3];   // p50, p99, p999
+        uint64_t pop_ns[3];
+        uint64_t e2e_ns[3];    // 从 push 之前到 pop 之后
+        int64_t cycles;        // 不可用时为 -1
+        int64_t cache_misses;
+    };
+
+    inline uint64_t now_ns()
+    {
+        return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    template<size_t Size>
+    struct Payload
+    {
+        uint64_t stamp;                                   // 采样项的写入时间, 其余为 0
+        array<char, Size - sizeof(uint64_t)> data;
+    };
+
+    // ---- 队列适配: Producer / Consumer 各自持有需要的令牌 ----
+
+    template<typename T>
+    struct LinkedQueue
+    {
+        Just::ConcurrentQueue<T> queue;
+
+        explicit LinkedQueue(const Config&) {}
+
+        struct Producer
+        {
+            LinkedQueue& q;
+            explicit Producer(LinkedQueue& owner) : q(owner) {}
+            bool push(const T& v) { return q.queue.push(v); }
+        };
+
+        struct Consumer
+        {
+            LinkedQueue& q;
+            explicit Consumer(LinkedQueue& owner) : q(owner) {}
+            bool pop(T& v) { return q.queue.pop(v); }
+        };
+    };
+
+    template<typename T>
+    struct BlockQueue
+    {
+        Just::ConcurrentQueue2<T> queue;
+
+        explicit BlockQueue(const Config&) {}
+
+        struct Producer
+        {
+            typename Just::ConcurrentQueue2<T>::Producer token;
+            explicit Producer(BlockQueue& owner) : token(owner.queue) {}
+            bool push(const T& v) { return token.push(v); }
+        };
+
+        struct Consumer
+        {
+            typename Just::ConcurrentQueue2<T>::Customer token;
+            explicit Consumer(BlockQueue& owner) : token(owner.queue) {}
+            bool pop(T& v) { return token.pop(v); }
+        };
+    };
+
+    template<typename T>
+    struct BoundedQueue
+    {
+        Just::BoundedQueue<T> queue;
+
+        explicit BoundedQueue(const Config& cfg) : queue(cfg.capacity) {}
+
+        struct Producer
+        {
+            BoundedQueue& q;
+            explicit Producer(BoundedQueue& owner) : q(owner) {}
+            bool push(const T& v) { return q.queue.try_push(v); }
+        };
+
+        struct Consumer
+        {
+            BoundedQueue& q;
+            explicit Consumer(BoundedQueue& owner) : q(owner) {}
+            bool pop(T& v) { return q.queue.try_pop(v); }
+        };
+    };
+
+    template<typename T>
+    struct SpscQueue
+    {
+        Just::SpscQueue<T> queue;
+
+        explicit SpscQueue(const Config& cfg) : queue(cfg.capacity) {}
+
+        struct Producer
+        {
+            SpscQueue& q;
+            explicit Producer(SpscQueue& owner) : q(owner) {}
+            bool push(const T& v) { return q.queue.try_push(v); }
+        };
+
+        struct Consumer
+        {
+            SpscQueue& q;
+            explicit Consumer(SpscQueue& owner) : q(owner) {}
+            bool pop(T& v) { return q.queue.try_pop(v); }
+        };
+    };
+
+#ifdef JUST_BENCH_MOODYCAMEL
+    template<typename T>
+    struct MoodycamelQueue
+    {
+        moodycamel::ConcurrentQueue<T> queue;
+
+        explicit MoodycamelQueue(const Config&) {}
+
+        struct Producer
+        {
+            MoodycamelQueue& q;
+            moodycamel::ProducerToken token;
+            explicit Producer(MoodycamelQueue& owner) : q(owner), token(owner.queue) {}
+            bool push(const T& v) { return q.queue.enqueue(token, v); }
+        };
+
+        struct Consumer
+        {
+            MoodycamelQueue& q;
+            moodycamel::ConsumerToken token;
+            explicit Consumer(MoodycamelQueue& owner) : q(owner), token(owner.queue) {}
+            bool pop(T& v) { return q.queue.try_dequeue(token, v); }
+        };
+    };
+#endif
+
+    // ---- 硬件计数器 ----
+
+    class PerfCounters
+    {
+#if defined(__linux__)
+        int _fds[2] = { -1, -1 };
+
+        static int open_counter(uint64_t config)
+        {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = config;
+            attr.disabled = 1;
+            attr.inherit = 1;          // 统计之后创建的测试线程
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+
+        static int64_t read_counter(int fd)
+        {
+            uint64_t value = 0;
+            if (fd < 0 || read(fd, &value, sizeof(value)) != static_cast<ssize_t>(sizeof(value)))
+                return -1;
+            return static_cast<int64_t>(value);
+        }
+
+    public:
+        explicit PerfCounters(bool enable)
+        {
+            if (!enable)
+                return;
+            _fds[0] = open_counter(PERF_COUNT_HW_CPU_CYCLES);
+            _fds[1] = open_counter(PERF_COUNT_HW_CACHE_MISSES);
+        }
+
+        ~PerfCounters()
+        {
+            for (int fd : _fds)
+            {
+                if (fd >= 0)
+                    close(fd);
+            }
+        }
+
+        bool available() const
+        {
+            return _fds[0] >= 0;
+        }
+
+        void start()
+        {
+            for (int fd : _fds)
+            {
+                if (fd >= 0) {
+                    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+                }
+            }
+        }
+
+        void stop(int64_t& cycles, int64_t& cache_misses)
+        {
+            for (int fd : _fds)
+            {
+                if (fd >= 0)
+                    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            }
+            cycles = read_counter(_fds[0]);
+            cache_misses = read_counter(_fds[1]);
+        }
+#else
+    public:
+        explicit PerfCounters(bool) {}
+        bool available() const { return false; }
+        void start() {}
+        void stop(int64_t& cycles, int64_t& cache_misses) { cycles = -1; cache_misses = -1; }
+#endif
+    };
+
+    // ---- 单次运行 ----
+
+    void percentiles(vector<uint32_t>& samples, uint64_t out[3])
+    {
+        if (samples.empty()) {
+            out[0] = out[1] = out[2] = 0;
+            return;
+        }
+        sort(samples.begin(), samples.end());
+        const double ranks[3] = { 0.5, 0.99, 0.999 };
+        for (size_t i = 0; i < 3; i++)
+        {
+            size_t index = static_cast<size_t>(ranks[i] * static_cast<double>(samples.size() - 1));
+            out[i] = samples[index];
+        }
+    }
+
+    inline void record(vector<uint32_t>& samples, uint64_t ns)
+    {
+        samples.push_back(static_cast<uint32_t>(min<uint64_t>(ns, UINT32_MAX)));
+    }
+
+    inline void backoff(size_t& fails)
+    {
+        if (++fails >= SPIN_BEFORE_YIELD) {
+            fails = 0;
+            this_thread::yield();
+        }
+    }
+
+    template<template<typename> class Queue, size_t Size>
+    Result run_once(const Config& cfg, const string& name, size_t producers, size_t consumers, size_t burst, size_t ops, PerfCounters& perf)
+    {
+        using T = Payload<Size>;
+        Queue<T> queue(cfg);
+        const size_t per_producer = ops / producers;
+        const size_t total = per_producer * producers;
+
+        atomic<size_t> ready { 0 };
+        atomic<bool> go { false };
+        atomic<size_t> consumed { 0 };
+        vector<vector<uint32_t>> push_samples(producers);
+        vector<vector<uint32_t>> pop_samples(consumers);
+        vector<vector<uint32_t>> e2e_samples(consumers);
+        vector<thread> threads;
+
+        for (size_t p = 0; p < producers; p++)
+        {
+            threads.emplace_back([&, p]() {
+                typename Queue<T>::Producer producer(queue);
+                vector<uint32_t>& samples = push_samples[p];
+                samples.reserve(per_producer / SAMPLE_INTERVAL + 1);
+                T item {};
+                ++ready;
+                while (!go.load(memory_order_acquire))
+                    this_thread::yield();
+
+                size_t fails = 0;
+                for (size_t i = 0; i < per_producer; i++)
+                {
+                    const bool sampled = i % SAMPLE_INTERVAL == 0;
+                    const uint64_t begin = sampled ? now_ns() : 0;
+                    item.stamp = begin;
+                    while (!producer.push(item))
+                        backoff(fails);
+                    if (sampled)
+                        record(samples, now_ns() - begin);
+
+                    if (burst && (i + 1) % burst == 0) {
+                        const uint64_t until = now_ns() + cfg.burst_gap_us * 1000;
+                        while (now_ns() < until)
+                            Just::cpu_relax();
+                    }
+                }
+            });
+        }
+
+        for (size_t c = 0; c < consumers; c++)
+        {
+            threads.emplace_back([&, c]() {
+                typename Queue<T>::Consumer consumer(queue);
+                vector<uint32_t>& pops = pop_samples[c];
+                vector<uint32_t>& e2e = e2e_samples[c];
+                pops.reserve(total / consumers / SAMPLE_INTERVAL + 1);
+                e2e.reserve(total / consumers / SAMPLE_INTERVAL + 1);
+                T item {};
+                ++ready;
+                while (!go.load(memory_order_acquire))
+                    this_thread::yield();
+
+                // 本地计数, 取空或满 256 个时才汇总, 避免共享计数器成为瓶颈
+                size_t local = 0;
+                size_t attempts = 0;
+                size_t fails = 0;
+                while (consumed.load(memory_order_relaxed) < total)
+                {
+                    const bool sampled = ++attempts % SAMPLE_INTERVAL == 0;
+                    const uint64_t begin = sampled ? now_ns() : 0;
+                    if (consumer.pop(item)) {
+                        const uint64_t end = (sampled || item.stamp) ? now_ns() : 0;
+                        if (sampled)
+                            record(pops, end - begin);
+                        if (item.stamp)
+                            record(e2e, end - item.stamp);
+                        if (++local == 256) {
+                            consumed.fetch_add(local, memory_order_relaxed);
+                            local = 0;
+                        }
+                    }
+                    else {
+                        if (local) {
+                            consumed.fetch_add(local, memory_order_relaxed);
+                            local = 0;
+                        }
+                        backoff(fails);
+                    }
+                }
+            });
+        }
+
+        while (ready.load() < producers + consumers)
+            this_thread::yield();
+
+        perf.start();
+        const uint64_t begin = now_ns();
+        go.store(true, memory_order_release);
+        for (auto& it : threads)
+        {
+            it.join();
+        }
+        const uint64_t end = now_ns();
+
+        Result r;
+        r.queue = name;
+        r.producers = producers;
+        r.consumers = consumers;
+        r.payload = Size;
+        r.burst = burst;
+        r.repeat = 0;
+        r.ops = total;
+        r.seconds = static_cast<double>(end - begin) / 1e9;
+        r.ops_per_sec = r.seconds > 0 ? static_cast<double>(total) / r.seconds : 0;
+        perf.stop(r.cycles, r.cache_misses);
+
+        vector<uint32_t> merged;
+        for (auto& it : push_samples)
+            merged.insert(merged.end(), it.begin(), it.end());
+        percentiles(merged, r.push_ns);
+        merged.clear();
+        for (auto& it : pop_samples)
+            merged.insert(merged.end(), it.begin(), it.end());
+        percentiles(merged, r.pop_ns);
+        merged.clear();
+        for (auto& it : e2e_samples)
+            merged.insert(merged.end(), it.begin(), it.end());
+        percentiles(merged, r.e2e_ns);
+        return r;
+    }
+
+    // ---- 输出 ----
+
+    class Writer
+    {
+        ostream& _out;
+        const Config& _cfg;
+        size_t _rows = 0;
+
+    public:
+        Writer(ostream& out, const Config& cfg)
+            : _out(out)
+            , _cfg(cfg)
+        {
+            if (_cfg.format == "json")
+                _out << "[" << endl;
+            else
+                _out << "label,queue,producers,consumers,payload,burst,repeat,ops,seconds,ops_per_sec,"
+                        "push_p50_ns,push_p99_ns,push_p999_ns,pop_p50_ns,pop_p99_ns,pop_p999_ns,"
+                        "e2e_p50_ns,e2e_p99_ns,e2e_p999_ns,cycles,cache_misses" << endl;
+        }
+
+        ~Writer()
+        {
+            if (_cfg.format == "json")
+                _out << endl << "]" << endl;
+        }
+
+        void write(const Result& r)
+        {
+            if (_cfg.format == "json") {
+                _out << (_rows ? ",\n" : "")
+                     << "  {\"label\": \"" << _cfg.label << "\", \"queue\": \"" << r.queue << "\""
+                     << ", \"producers\": " << r.producers << ", \"consumers\": " << r.consumers
+                     << ", \"payload\": " << r.payload << ", \"burst\": " << r.burst
+                     << ", \"repeat\": " << r.repeat << ", \"ops\": " << r.ops
+                     << ", \"seconds\": " << r.seconds << ", \"ops_per_sec\": " << static_cast<uint64_t>(r.ops_per_sec)
+                     << ", \"push_ns\": [" << r.push_ns[0] << ", " << r.push_ns[1] << ", " << r.push_ns[2] << "]"
+                     << ", \"pop_ns\": [" << r.pop_ns[0] << ", " << r.pop_ns[1] << ", " << r.pop_ns[2] << "]"
+                     << ", \"e2e_ns\": [" << r.e2e_ns[0] << ", " << r.e2e_ns[1] << ", " << r.e2e_ns[2] << "]"
+                     << ", \"cycles\": " << r.cycles << ", \"cache_misses\": " << r.cache_misses << "}";
+            }
+            else {
+                _out << _cfg.label << "," << r.queue << "," << r.producers << "," << r.consumers << ","
+                     << r.payload << "," << r.burst << "," << r.repeat << "," << r.ops << ","
+                     << r.seconds << "," << static_cast<uint64_t>(r.ops_per_sec) << ","
+                     << r.push_ns[0] << "," << r.push_ns[1] << "," << r.push_ns[2] << ","
+                     << r.pop_ns[0] << "," << r.pop_ns[1] << "," << r.pop_ns[2] << ","
+                     << r.e2e_ns[0] << "," << r.e2e_ns[1] << "," << r.e2e_ns[2] << ","
+                     << r.cycles << "," << r.cache_misses << endl;
+            }
+            _out.flush();
+            ++_rows;
+        }
+    };
+
+    // ---- 扫描 ----
+
+    template<template<typename> class Queue, size_t Size>
+    void sweep_payload(const Config& cfg, const string& name, Writer& writer, PerfCounters& perf)
+    {
+        for (size_t producers : cfg.producers)
+        {
+            for (size_t consumers : cfg.consumers)
+            {
+                if (name == "spsc" && (producers != 1 || consumers != 1))
+                    continue;
+
+                for (size_t burst : cfg.bursts)
+                {
+                    if (cfg.warmup)
+                        run_once<Queue, Size>(cfg, name, producers, consumers, burst, cfg.warmup, perf);
+
+                    for (size_t i = 0; i < cfg.repeat; i++)
+                    {
+                        Result r = run_once<Queue, Size>(cfg, name, producers, consumers, burst, cfg.ops, perf);
+                        r.repeat = i;
+                        writer.write(r);
+                    }
+                }
+            }
+        }
+    }
+
+    template<template<typename> class Queue>
+    void sweep(const Config& cfg, const string& name, Writer& writer, PerfCounters& perf)
+    {
+        for (size_t payload : cfg.payloads)
+        {
+            switch (payload)
+            {
+            case 8:
+                sweep_payload<Queue, 8>(cfg, name, writer, perf);
+                break;
+            case 64:
+                sweep_payload<Queue, 64>(cfg, name, writer, perf);
+                break;
+            case 256:
+                sweep_payload<Queue, 256>(cfg, name, writer, perf);
+                break;
+            default:
+                cerr << "unsupported payload size " << payload << " (8, 64, 256)" << endl;
+                break;
+            }
+        }
+    }
+
+    // ---- 命令行 ----
+
+    vector<string> split(const string& text)
+    {
+        vector<string> items;
+        stringstream ss(text);
+        string item;
+        while (getline(ss, item, ','))
+        {
+            if (!item.empty())
+                items.push_back(item);
+        }
+        return items;
+    }
+
+    vector<size_t> split_sizes(const string& text)
+    {
+        vector<size_t> values;
+        for (auto& it : split(text))
+            values.push_back(static_cast<size_t>(strtoull(it.c_str(), nullptr, 10)));
+        return values;
+    }
+
+    void usage()
+    {
+        cerr << "usage: bench [options]\n"
+                "  --queues linked,block,bounded,spsc,moodycamel\n"
+                "  --producers 1,4      --consumers 1,4\n"
+                "  --payload 8,64,256   --burst 0,64   --burst-gap-us 20\n"
+                "  --ops 1000000        --warmup 100000   --repeat 3   --capacity 65536\n"
+                "  --perf               read cycles and cache-misses with perf_event_open\n"
+                "  --format csv|json    --out FILE   --label TEXT" << endl;
+    }
+
+    bool parse(int argc, char* argv[], Config& cfg)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            string arg = argv[i];
+            auto value = [&]() -> string {
+                return i + 1 < argc ? argv[++i] : string();
+            };
+
+            if (arg == "--queues") cfg.queues = split(value());
+            else if (arg == "--producers") cfg.producers = split_sizes(value());
+            else if (arg == "--consumers") cfg.consumers = split_sizes(value());
+            else if (arg == "--payload") cfg.payloads = split_sizes(value());
+            else if (arg == "--burst") cfg.bursts = split_sizes(value());
+            else if (arg == "--burst-gap-us") cfg.burst_gap_us = strtoull(value().c_str(), nullptr, 10);
+            else if (arg == "--ops") cfg.ops = strtoull(value().c_str(), nullptr, 10);
+            else if (arg == "--warmup") cfg.warmup = strtoull(value().c_str(), nullptr, 10);
+            else if (arg == "--repeat") cfg.repeat = strtoull(value().c_str(), nullptr, 10);
+            else if (arg == "--capacity") cfg.capacity = strtoull(value().c_str(), nullptr, 10);
+            else if (arg == "--perf") cfg.perf = true;
+            else if (arg == "--format") cfg.format = value();
+            else if (arg == "--out") cfg.out = value();
+            else if (arg == "--label") cfg.label = value();
+            else {
+                usage();
+                return false;
+            }
+        }
+
+        // 每个线程至少一次操作
+        cfg.producers.erase(remove(cfg.producers.begin(), cfg.producers.end(), size_t(0)), cfg.producers.end());
+        cfg.consumers.erase(remove(cfg.consumers.begin(), cfg.consumers.end(), size_t(0)), cfg.consumers.end());
+        return cfg.format == "csv" || cfg.format == "json";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Config cfg;
+    if (!parse(argc, argv, cfg))
+        return 1;
+
+    ofstream file;
+    if (!cfg.out.empty())
+        file.open(cfg.out);
+    ostream& out = cfg.out.empty() ? cout : file;
+
+    PerfCounters perf(cfg.perf);
+    if (cfg.perf && !perf.available())
+        cerr << "perf_event_open unavailable, cycles and cache_misses are reported as -1" << endl;
+
+    Writer writer(out, cfg);
+    for (auto& name : cfg.queues)
+    {
+        if (name == "linked")
+            sweep<LinkedQueue>(cfg, name, writer, perf);
+        else if (name == "block")
+            sweep<BlockQueue>(cfg, name, writer, perf);
+        else if (name == "bounded")
+            sweep<BoundedQueue>(cfg, name, writer, perf);
+        else if (name == "spsc")
+            sweep<SpscQueue>(cfg, name, writer, perf);
+#ifdef JUST_BENCH_MOODYCAMEL
+        else if (name == "moodycamel")
+            sweep<MoodycamelQueue>(cfg, name, writer, perf);
+#endif
+        else
+            cerr << "skip queue " << name << endl;
+    }
+
+    return 0;
+}
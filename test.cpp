@@ -1,7 +1,14 @@
 
 #include "Just/JustThreadPool.h"
 #include "Just/JustConcurrentQueue.hpp"
-// #include "Just/JustCQ.hpp"
+#include "Just/JustCQ.hpp"
+#include "Just/JustBoundedQueue.hpp"
+#include "Just/JustSpscQueue.hpp"
+#include "Just/JustParallel.hpp"
+#include "Just/JustStrand.hpp"
+#include "Just/JustBasicThreadPool.hpp"
+#include "Just/JustTaskGraph.hpp"
+#include "Just/JustCoroutine.hpp"
 
 #include <bits/stdint-uintn.h>
 #include <concurrentqueue/concurrentqueue.h>
@@ -14,15 +21,34 @@
 #include <queue>
 #include <atomic>
 #include <sys/types.h>
+#include <sys/resource.h>
 #include <typeinfo>
 #include <vector>
 #include <thread>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+#include <algorithm>
 #include <iostream>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
 using namespace std;
 
 #define COUNT (20000000)
 const size_t PUSH_THREADS = (10);
 const size_t POP_THREADS = (7);
+const size_t BULK_SIZE = (64);
+
+// 功能测试的检查, 失败时输出原因并退出
+void expect(bool ok, const char* what)
+{
+    if (!ok)
+    {
+        cout << "FAILED: " << what << endl;
+        exit(1);
+    }
+}
 
 // push
 template<typename T, const size_t Count = COUNT>
@@ -85,6 +111,67 @@ void test_queue02(Just::ConcurrentQueue<T>& cq)
     cout << "popend " << pop_num << endl;
 }
 
+// push_bulk
+template<typename T, const size_t Count = COUNT>
+void test_queue01_bulk(Just::ConcurrentQueue<T>& cq)
+{
+    vector<thread> push_threads;
+
+    cout << "push_bulk" << endl;
+    cout << "cq empyt: " << cq.empty() << endl;
+    cout << "cq size: " << cq.size() << endl;
+    for (size_t i = 0; i < 10; i++)
+    {
+        push_threads.emplace_back([i, &cq](){
+            vector<T> items(BULK_SIZE);
+            for (size_t j = 0; j < Count; j += BULK_SIZE)
+            {
+                cq.push_bulk(items.begin(), items.begin() + min(BULK_SIZE, Count - j));
+            }
+        });
+    }
+
+    for (auto& it : push_threads)
+    {
+        it.join();
+    }
+
+    cout << "cq empyt: " << cq.empty() << endl;
+    cout << "cq size: " << cq.size() << endl;
+    cout << "push_bulk end" << endl;
+}
+
+// pop_bulk
+template<typename T, const size_t Count = COUNT>
+void test_queue02_bulk(Just::ConcurrentQueue<T>& cq)
+{
+    vector<thread> pop_threads;
+    atomic_uint32_t pop_num(0);
+    cout << "pop_bulk" << endl;
+    cout << "cq empyt: " << cq.empty() << endl;
+    cout << "cq size: " << cq.size() << endl;
+
+    for (size_t i = 0; i < 10; i++)
+    {
+        pop_threads.emplace_back([i, &cq, &pop_num](){
+            vector<T> items(BULK_SIZE);
+            for (size_t j = 0; j < Count; j += BULK_SIZE)
+            {
+                pop_num += cq.pop_bulk(items.begin(), BULK_SIZE);
+            }
+        });
+    }
+
+    for (auto& it : pop_threads)
+    {
+        it.join();
+    }
+
+    cout << "cq empyt: " << cq.empty() << endl;
+    cout << "cq size: " << cq.size() << endl;
+    cout << "pop_bulk end " << pop_num << endl;
+}
+
 /*
 real    0m40.486s
 user    4m34.419s
@@ -176,6 +263,7 @@ void test_queue03()
     cout << "pop num: " << pop_num << endl;
     cout << "cq empyt: " << cq.empty() << endl;
     cout << "cq size: " << cq.size() << endl;
+    cout << "cq allocations: " << cq.allocations() << endl;
 }
 
 /*
@@ -213,24 +301,82 @@ sys     0m0.591s
 
 */
 
-/*
+// push_bulk and pop_bulk
 template<typename T, const size_t Count = COUNT>
-void test_queue04()
+void test_queue03_bulk()
 {
     atomic_uint32_t pop_num;
     atomic_init(&pop_num, 0U);
     vector<thread> push_threads;
     vector<thread> pop_threads;
 
-    moodycamel::ConcurrentQueue<T> cq;
+    Just::ConcurrentQueue<int> cq;
+
+    for (size_t i = 0; i < PUSH_THREADS; i++)
+    {
+        push_threads.emplace_back([i, &cq](){
+            cout << "push start" << endl;
+            vector<int> items(BULK_SIZE);
+            for (size_t j = 0; j < Count; j += BULK_SIZE)
+            {
+                size_t n = min(BULK_SIZE, Count - j);
+                for (size_t k = 0; k < n; k++)
+                {
+                    items[k] = (j + k) * i;
+                }
+                cq.push_bulk(items.begin(), items.begin() + n);
+            }
+            cout << "push end" << endl;
+            });
+    }
+
+    for (size_t i = 0; i < POP_THREADS; i++)
+    {
+        pop_threads.emplace_back([i, &cq, &pop_num](){
+            cout << "pop start" << endl;
+            vector<int> items(BULK_SIZE);
+                for (size_t i = 0; i < Count * 10; i += BULK_SIZE)
+                {
+                    pop_num += cq.pop_bulk(items.begin(), BULK_SIZE);
+                }
+                cout << "pop end" << endl;
+            });
+    }
+
+    for (auto& it : push_threads)
+    {
+        it.join();
+    }
+
+    for (auto& it : pop_threads)
+    {
+        it.join();
+    }
+
+    cout << "pop num: " << pop_num << endl;
+    cout << "cq empyt: " << cq.empty() << endl;
+    cout << "cq size: " << cq.size() << endl;
+    cout << "cq allocations: " << cq.allocations() << endl;
+}
+
+template<typename T, const size_t Count = COUNT>
+void test_queue05()
+{
+    atomic_uint32_t pop_num;
+    atomic_init(&pop_num, 0U);
+    vector<thread> push_threads;
+    vector<thread> pop_threads;
+
+    Just::ConcurrentQueue2<T> cq;
 
     for (size_t i = 0; i < PUSH_THREADS; i++)
     {
         push_threads.emplace_back([i, &cq](){
             cout << "push start" << endl;
+            typename Just::ConcurrentQueue2<T>::Producer p(cq);
             for (size_t j = 0; j < Count; j++)
             {
-                cq.enqueue(j * i);
+                p.push(j * i);
             }
             cout << "push end" << endl;
             });
@@ -240,10 +386,11 @@ void test_queue04()
     {
         pop_threads.emplace_back([i, &cq, &pop_num](){
             cout << "pop start" << endl;
-            int tmp;
+            typename Just::ConcurrentQueue2<T>::Customer c(cq);
+            T tmp;
                 for (size_t i = 0; i < Count * 10; ++i)
                 {
-                    if (cq.try_dequeue(tmp))
+                    if (c.pop(tmp))
                         ++pop_num;
                 }
                 cout << "pop end" << endl;
@@ -261,12 +408,12 @@ void test_queue04()
     }
 
     cout << "pop num: " << pop_num << endl;
-    // cout << "cq empyt: " << cq.size_approx() << endl;
-    cout << "cq size: " << cq.size_approx() << endl;
+    cout << "cq size: " << cq.size() << endl;
 }
 
-template<typename T>
-void test_queue05()
+// push_bulk and pop_bulk
+template<typename T, const size_t Count = COUNT>
+void test_queue05_bulk()
 {
     atomic_uint32_t pop_num;
     atomic_init(&pop_num, 0U);
@@ -275,19 +422,74 @@ void test_queue05()
 
     Just::ConcurrentQueue2<T> cq;
 
-    typename Just::ConcurrentQueue2<T>::Producer p(nullptr);
-    typename Just::ConcurrentQueue2<T>::Customer c(nullptr);
+    for (size_t i = 0; i < PUSH_THREADS; i++)
+    {
+        push_threads.emplace_back([i, &cq](){
+            cout << "push start" << endl;
+            typename Just::ConcurrentQueue2<T>::Producer p(cq);
+            vector<T> items(BULK_SIZE);
+            for (size_t j = 0; j < Count; j += BULK_SIZE)
+            {
+                size_t n = min(BULK_SIZE, Count - j);
+                for (size_t k = 0; k < n; k++)
+                {
+                    items[k] = (j + k) * i;
+                }
+                p.push_bulk(items.begin(), items.begin() + n);
+            }
+            cout << "push end" << endl;
+            });
+    }
+
+    for (size_t i = 0; i < POP_THREADS; i++)
+    {
+        pop_threads.emplace_back([i, &cq, &pop_num](){
+            cout << "pop start" << endl;
+            typename Just::ConcurrentQueue2<T>::Customer c(cq);
+            vector<T> items(BULK_SIZE);
+                for (size_t i = 0; i < Count * 10; i += BULK_SIZE)
+                {
+                    pop_num += c.pop_bulk(items.begin(), BULK_SIZE);
+                }
+                cout << "pop end" << endl;
+            });
+    }
+
+    for (auto& it : push_threads)
+    {
+        it.join();
+    }
+
+    for (auto& it : pop_threads)
+    {
+        it.join();
+    }
+
+    cout << "pop num: " << pop_num << endl;
+    cout << "cq size: " << cq.size() << endl;
+}
+
+// 有界环形队列, 与 test_queue03 相同的 10 生产者 7 消费者
+template<typename T, const size_t Count = COUNT, const size_t Capacity = (1 << 16)>
+void test_queue06()
+{
+    atomic_uint32_t pop_num;
+    atomic_init(&pop_num, 0U);
+    vector<thread> push_threads;
+    vector<thread> pop_threads;
 
-    cq.CreateProducer(p);
-    cq.CreateCustomer(c);
+    Just::BoundedQueue<T> cq(Capacity);
 
     for (size_t i = 0; i < PUSH_THREADS; i++)
     {
-        push_threads.emplace_back([i, &p](){
+        push_threads.emplace_back([i, &cq](){
             cout << "push start" << endl;
-            for (size_t j = 0; j < COUNT; j++)
+            for (size_t j = 0; j < Count; j++)
             {
-                p.push(j * i);
+                while (!cq.try_push(j * i))
+                {
+                    this_thread::yield();
+                }
             }
             cout << "push end" << endl;
             });
@@ -295,12 +497,160 @@ void test_queue05()
 
     for (size_t i = 0; i < POP_THREADS; i++)
     {
-        pop_threads.emplace_back([i, &c, &pop_num](){
+        pop_threads.emplace_back([i, &cq, &pop_num](){
+            cout << "pop start" << endl;
+            T tmp;
+                // 队列满时生产者会等待, 消费者必须取完所有元素
+                while (pop_num < PUSH_THREADS * Count)
+                {
+                    if (cq.try_pop(tmp))
+                        ++pop_num;
+                }
+                cout << "pop end" << endl;
+            });
+    }
+
+    for (auto& it : push_threads)
+    {
+        it.join();
+    }
+
+    for (auto& it : pop_threads)
+    {
+        it.join();
+    }
+
+    cout << "pop num: " << pop_num << endl;
+    cout << "cq empyt: " << cq.empty() << endl;
+    cout << "cq size: " << cq.size() << endl;
+}
+
+// 单生产者单消费者吞吐, Bulk 为 0 时逐个 push pop
+template<typename T, const size_t Count = COUNT, const size_t Bulk = 0>
+void test_spsc01()
+{
+    Just::SpscQueue<T> cq(1 << 16);
+    size_t pop_num = 0;
+
+    auto begin = chrono::steady_clock::now();
+    thread push_thread([&cq](){
+        vector<T> items(Bulk ? Bulk : 1);
+        for (size_t j = 0; j < Count; )
+        {
+            if (Bulk)
+            {
+                size_t n = min(Bulk, Count - j);
+                size_t pushed = 0;
+                while (pushed < n)
+                {
+                    pushed += cq.push_bulk(items.begin() + pushed, items.begin() + n);
+                }
+                j += n;
+            }
+            else
+            {
+                while (!cq.try_push(T(j)))
+                {
+                    Just::cpu_relax();
+                }
+                ++j;
+            }
+        }
+    });
+
+    thread pop_thread([&cq, &pop_num](){
+        vector<T> items(Bulk ? Bulk : 1);
+        while (pop_num < Count)
+        {
+            if (Bulk)
+                pop_num += cq.pop_bulk(items.begin(), Bulk);
+            else if (cq.try_pop(items[0]))
+                ++pop_num;
+        }
+    });
+
+    push_thread.join();
+    pop_thread.join();
+    auto end = chrono::steady_clock::now();
+
+    auto ns = chrono::duration_cast<chrono::nanoseconds>(end - begin).count();
+    cout << "spsc bulk " << Bulk << ": " << pop_num << " in " << ns / 1000000 << "ms, "
+         << (ns ? pop_num * 1000000000ull / ns : 0) << " ops/s" << endl;
+}
+
+// 单生产者单消费者往返延迟
+template<const size_t Rounds = 1000000>
+void test_spsc02()
+{
+    Just::SpscQueue<size_t> ping(64);
+    Just::SpscQueue<size_t> pong(64);
+
+    thread echo_thread([&ping, &pong](){
+        size_t v = 0;
+        for (size_t i = 0; i < Rounds; i++)
+        {
+            while (!ping.try_pop(v))
+            {
+                Just::cpu_relax();
+            }
+            while (!pong.try_push(v))
+            {
+                Just::cpu_relax();
+            }
+        }
+    });
+
+    auto begin = chrono::steady_clock::now();
+    size_t v = 0;
+    for (size_t i = 0; i < Rounds; i++)
+    {
+        while (!ping.try_push(i))
+        {
+            Just::cpu_relax();
+        }
+        while (!pong.try_pop(v))
+        {
+            Just::cpu_relax();
+        }
+    }
+    auto end = chrono::steady_clock::now();
+    echo_thread.join();
+
+    auto ns = chrono::duration_cast<chrono::nanoseconds>(end - begin).count();
+    cout << "spsc ping-pong: " << Rounds << " rounds, " << ns / Rounds << "ns per round trip" << endl;
+}
+
+/*
+template<typename T, const size_t Count = COUNT>
+void test_queue04()
+{
+    atomic_uint32_t pop_num;
+    atomic_init(&pop_num, 0U);
+    vector<thread> push_threads;
+    vector<thread> pop_threads;
+
+    moodycamel::ConcurrentQueue<T> cq;
+
+    for (size_t i = 0; i < PUSH_THREADS; i++)
+    {
+        push_threads.emplace_back([i, &cq](){
+            cout << "push start" << endl;
+            for (size_t j = 0; j < Count; j++)
+            {
+                cq.enqueue(j * i);
+            }
+            cout << "push end" << endl;
+            });
+    }
+
+    for (size_t i = 0; i < POP_THREADS; i++)
+    {
+        pop_threads.emplace_back([i, &cq, &pop_num](){
             cout << "pop start" << endl;
             int tmp;
-                for (size_t i = 0; i < COUNT * 10; ++i)
+                for (size_t i = 0; i < Count * 10; ++i)
                 {
-                    if (c.pop(tmp))
+                    if (cq.try_dequeue(tmp))
                         ++pop_num;
                 }
                 cout << "pop end" << endl;
@@ -319,8 +669,9 @@ void test_queue05()
 
     cout << "pop num: " << pop_num << endl;
     // cout << "cq empyt: " << cq.size_approx() << endl;
-    // cout << "cq size: " << cq.size_approx() << endl;
+    cout << "cq size: " << cq.size_approx() << endl;
 }
+
 */
 /*
 10000000
@@ -380,42 +731,882 @@ void test_queue05()
 }
 */
 
-int main(int argc, char* argv[])
+// 线程池调度器对比: 任务在线程池内部递归派生, 共 2^Depth 个叶子任务
+template<const size_t Depth = 20>
+void test_pool01()
+{
+    using Scheduler = Just::ThreadPool::Scheduler;
+
+    for (Scheduler sched : { Scheduler::Shared, Scheduler::WorkStealing })
+    {
+        cout << (sched == Scheduler::Shared ? "shared" : "work stealing") << endl;
+        for (size_t threads = 1; threads <= thread::hardware_concurrency(); threads *= 2)
+        {
+            Just::ThreadPool tpool(threads, sched);
+            atomic<size_t> leaf_num(0);
+
+            function<void(size_t)> spawn = [&tpool, &leaf_num, &spawn](size_t depth) {
+                if (depth == 0)
+                {
+                    ++leaf_num;
+                    return;
+                }
+                tpool.run([&spawn, depth]() { spawn(depth - 1); });
+                tpool.run([&spawn, depth]() { spawn(depth - 1); });
+            };
+
+            auto begin = chrono::steady_clock::now();
+            tpool.run([&spawn]() { spawn(Depth); });
+            while (leaf_num < (size_t(1) << Depth))
+            {
+                this_thread::yield();
+            }
+            auto end = chrono::steady_clock::now();
+
+            cout << "threads: " << threads
+                 << " time: " << chrono::duration_cast<chrono::milliseconds>(end - begin).count() << "ms" << endl;
+        }
+    }
+}
+
+// 长期存在的线程反复创建短命的队列, 线程私有的槽位缓存不应随之增长
+void test_slots01()
+{
+    Just::ConcurrentQueue<int> keep;
+    Just::ConcurrentQueue2<int> keep2;
+    int tmp = 0;
+    for (size_t i = 0; i < 10000; i++)
+    {
+        Just::ConcurrentQueue<int> cq;
+        Just::ConcurrentQueue2<int> cq2;
+        cq.push(int(i));
+        cq2.push(int(i));
+        keep.push(int(i));
+        keep2.push(int(i));
+        expect(cq.pop(tmp) && cq2.pop(tmp) && keep.pop(tmp) && keep2.pop(tmp), "slots: pop after push");
+    }
+
+    size_t cached = Just::detail::thread_slot_cache().slots.size();
+    cout << "slot cache entries: " << cached << endl;
+    expect(cached <= 4, "slots: entries of destroyed queues are dropped");
+}
+
+// 共享队列模式下批量取出的任务: 任务 0 等待任务 1, 其余的线程需要能拿到任务 1
+void test_pool03()
 {
-    // test_queue05<int>();
+    for (size_t round = 0; round < 20; round++)
+    {
+        Just::ThreadPool tpool(2, Just::ThreadPool::Scheduler::Shared);
+        atomic<bool> flag(false);
+        atomic<bool> seen(false);
+        atomic<size_t> done_num(0);
+
+        vector<function<void()>> jobs;
+        jobs.emplace_back([&]() {
+            auto deadline = chrono::steady_clock::now() + chrono::seconds(1);
+            while (!flag && chrono::steady_clock::now() < deadline)
+            {
+                this_thread::yield();
+            }
+            seen = flag.load();
+            ++done_num;
+        });
+        jobs.emplace_back([&]() {
+            flag = true;
+            ++done_num;
+        });
+        for (size_t i = 2; i < 64; i++)
+        {
+            jobs.emplace_back([&]() { ++done_num; });
+        }
+
+        tpool.post_bulk(jobs.begin(), jobs.end());
+        while (done_num < jobs.size())
+        {
+            this_thread::yield();
+        }
+        expect(seen, "shared batch: task 1 runs while task 0 waits for it");
+    }
+    cout << "shared batch: ok" << endl;
+}
 
-    // Just::ConcurrentQueue2<int> cq;
-    // typename Just::ConcurrentQueue2<int>::Producer p(nullptr);
-    // typename Just::ConcurrentQueue2<int>::Customer c(nullptr);
+// 定时任务: 到期顺序, 不提前触发, 取消, 周期任务取消后不再触发
+void test_timer01()
+{
+    // 同一时刻到期的任务在多个线程上执行时没有先后, 用一个线程检查顺序
+    Just::ThreadPool tpool(1);
+    mutex order_mutex;
+    vector<int> order;
+    auto begin = chrono::steady_clock::now();
+    promise<chrono::steady_clock::time_point> fired;
+
+    tpool.run_after(chrono::milliseconds(30), [&]() { lock_guard<mutex> locker(order_mutex); order.push_back(30); });
+    tpool.run_after(chrono::milliseconds(10), [&]() { lock_guard<mutex> locker(order_mutex); order.push_back(10); });
+    tpool.run_at(chrono::system_clock::now() + chrono::milliseconds(20), [&]() { lock_guard<mutex> locker(order_mutex); order.push_back(20); });
+    tpool.run_after(chrono::milliseconds(20), [&]() { fired.set_value(chrono::steady_clock::now()); });
+
+    atomic<bool> cancelled_ran(false);
+    Just::TimerHandle handle = tpool.run_after(chrono::milliseconds(50), [&]() { cancelled_ran = true; });
+    expect(handle.cancel(), "timer: cancel a pending timer");
+    expect(!handle.cancel(), "timer: second cancel fails");
+
+    atomic<size_t> ticks(0);
+    Just::TimerHandle every = tpool.run_every(chrono::milliseconds(5), [&]() { ++ticks; });
+
+    expect(fired.get_future().get() - begin >= chrono::milliseconds(19), "timer: not fired early");
+    this_thread::sleep_for(chrono::milliseconds(80));
+    expect(every.cancel(), "timer: cancel a periodic timer");
+    this_thread::sleep_for(chrono::milliseconds(10));
+    size_t ticks_at_cancel = ticks;
+    this_thread::sleep_for(chrono::milliseconds(30));
 
-    // cq.CreateProducer(p);
+    {
+        lock_guard<mutex> locker(order_mutex);
+        expect(order == vector<int>({ 10, 20, 30 }), "timer: fire in deadline order");
+    }
+    expect(!cancelled_ran, "timer: cancelled timer does not run");
+    expect(ticks_at_cancel >= 5, "timer: periodic timer fires repeatedly");
+    expect(ticks == ticks_at_cancel, "timer: periodic timer stops after cancel");
+    cout << "timer: ok, periodic ticks " << ticks_at_cancel << endl;
+}
 
-    // p.push(10);
+// 在 timeout 内等待 pred 成立
+template<typename Pred>
+bool wait_until(Pred&& pred, chrono::milliseconds timeout = chrono::milliseconds(2000))
+{
+    auto deadline = chrono::steady_clock::now() + timeout;
+    while (!pred())
+    {
+        if (chrono::steady_clock::now() >= deadline)
+            return false;
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    return true;
+}
 
-    // std::thread th([&p](){
-    //     for (int i = 0; i < 1023; i++) {
-    //         p.push(i);
-    //     }
-    // });
+// resize 增减线程, 以及弹性模式下随负载增加线程, 空闲超过 keep_alive 后收缩
+void test_resize01()
+{
+    {
+        Just::ThreadPool tpool(2);
+        expect(tpool.thread_count() == 2 && tpool.active_thread_count() == 2, "resize: initial thread count");
+        tpool.resize(1);
+        expect(tpool.thread_count() == 1, "resize: configured count follows resize");
+        expect(wait_until([&]() { return tpool.active_thread_count() == 1; }), "resize: shrink to 1");
+
+        atomic<size_t> done_num(0);
+        for (size_t i = 0; i < 100; i++)
+        {
+            tpool.post([&]() { ++done_num; });
+        }
+        expect(wait_until([&]() { return done_num == 100; }), "resize: tasks run after shrinking");
+
+        tpool.resize(2);
+        expect(tpool.active_thread_count() == 2, "resize: grow back to 2");
+
+        tpool.stop();
+        expect(tpool.thread_count() == 2 && tpool.active_thread_count() == 0, "resize: stop keeps the configured count");
+    }
 
-    // // std::thread th1([&p](){
-    // //     for (int i = 0; i < 1000; i++) {
-    // //         p.push(i);
-    // //     }
-    // // });
+    {
+        Just::ThreadPool::Options opts;
+        opts.thread_hint = 1;
+        opts.max_threads = 4;
+        opts.grow_threshold = 1;
+        opts.keep_alive = chrono::milliseconds(50);
+        Just::ThreadPool tpool(opts);
+        expect(tpool.max_thread_count() == 4, "elastic: max thread count");
+
+        // 占住线程并积压任务, 定时线程检测到负载后增加线程
+        atomic<bool> gate(false);
+        atomic<size_t> done_num(0);
+        for (size_t i = 0; i < 16; i++)
+        {
+            tpool.post([&]() {
+                while (!gate)
+                {
+                    this_thread::sleep_for(chrono::milliseconds(1));
+                }
+                ++done_num;
+            });
+        }
+        expect(wait_until([&]() { return tpool.active_thread_count() > 1; }), "elastic: grow under load");
+        size_t grown = tpool.active_thread_count();
+        expect(tpool.thread_count() == 1, "elastic: thread_count stays at the lower bound");
+        expect(grown <= 4, "elastic: stay within max_threads");
+
+        gate = true;
+        expect(wait_until([&]() { return done_num == 16; }), "elastic: all tasks run");
+        expect(wait_until([&]() { return tpool.active_thread_count() == 1; }), "elastic: shrink back after keep_alive");
+        cout << "resize: ok, elastic grew to " << grown << " threads" << endl;
+    }
+}
 
-    // // std::thread th2([&p](){
-    // //     for (int i = 0; i < 1000; i++) {
-    // //         p.push(i);
-    // //     }
-    // // });
+// 取消: cancel_all 丢弃排队中的任务, 取消标记跳过尚未开始的任务, 被丢弃的 future 得到 broken_promise
+// 析构时在所属线程池中取一个任务执行, 用于检查清除队列时的重入
+struct RunPendingOnDestroy
+{
+    Just::ThreadPool* pool;
+    atomic<size_t>* destroyed;
+
+    RunPendingOnDestroy(Just::ThreadPool* p, atomic<size_t>* d)
+        : pool(p), destroyed(d)
+    {}
 
-    // th.join();
-    // //th1.join();
-    // //th2.join();
+    RunPendingOnDestroy(RunPendingOnDestroy&& other)
+        : pool(other.pool), destroyed(other.destroyed)
+    {
+        other.pool = nullptr;
+    }
+
+    ~RunPendingOnDestroy()
+    {
+        if (pool)
+        {
+            pool->run_pending_task();
+            ++*destroyed;
+        }
+    }
+};
+
+void test_cancel01()
+{
+    const size_t count = 100;
+    Just::ThreadPool tpool(1);
+    atomic<bool> started(false);
+    atomic<bool> gate(false);
+    atomic<size_t> ran(0);
+
+    // 占住唯一的线程, 之后提交的任务都在排队
+    tpool.post([&]() {
+        started = true;
+        while (!gate)
+        {
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+    });
+    expect(wait_until([&]() { return started.load(); }), "cancel: gate task started");
+
+    auto broken = [](future<void>& fut) {
+        try {
+            fut.get();
+        }
+        catch (const future_error& e) {
+            return e.code() == make_error_code(future_errc::broken_promise);
+        }
+        return false;
+    };
+
+    vector<future<void>> futs;
+    for (size_t i = 0; i < count; i++)
+    {
+        futs.emplace_back(tpool.run([&]() { ++ran; }));
+    }
+    expect(tpool.cancel_all() == count, "cancel: cancel_all returns the dropped count");
+    expect(tpool.task_count() == 0, "cancel: queue empty after cancel_all");
+    for (auto& it : futs)
+    {
+        expect(broken(it), "cancel: dropped run future gets broken_promise");
+    }
 
-    // p.push(10);
-    // p.push(11);
+    Just::CancelSource source;
+    futs.clear();
+    for (size_t i = 0; i < count; i++)
+    {
+        futs.emplace_back(tpool.run(source.token(), [&]() { ++ran; }));
+        tpool.post(source.token(), [&]() { ++ran; });
+    }
+    auto kept = tpool.run([&]() { ++ran; });
+    expect(source.cancel(), "cancel: first cancel");
+    expect(!source.cancel(), "cancel: second cancel");
+
+    gate = true;
+    kept.get();
+    for (auto& it : futs)
+    {
+        expect(broken(it), "cancel: cancelled token future gets broken_promise");
+    }
+    expect(ran == 1, "cancel: only the untokened task runs");
+
+    // 在线程池的任务中调用不会与 stop 争锁
+    expect(tpool.run([&]() { return tpool.cancel_all(); }).get() == 0, "cancel: cancel_all from a task");
+
+    // 被丢弃任务的析构中再从同一队列取任务
+    atomic<size_t> destroyed(0);
+    auto reentered = tpool.run([&]() {
+        for (size_t i = 0; i < count; i++)
+        {
+            tpool.post(Just::ThreadPool::Priority::Low, [guard = RunPendingOnDestroy(&tpool, &destroyed)]() {});
+        }
+        return tpool.cancel_all();
+    });
+    expect(reentered.get() == count && destroyed == count, "cancel: destructors of dropped tasks may pop again");
+    cout << "cancel: ok" << endl;
+}
+
+// 任务中等待同一线程池的子任务: 单线程的线程池中 wait / help_while 执行排队中的任务而不是死锁
+void test_wait01()
+{
+    Just::ThreadPool tpool(1);
+    expect(!tpool.run_pending_task(), "wait: run_pending_task off the pool");
+
+    // 递归地在任务中提交子任务并等待, 每一层都只能由等待中的线程自己执行
+    function<int(int)> fib = [&](int n) {
+        if (n < 2)
+        {
+            return n;
+        }
+        auto left = tpool.run(fib, n - 1);
+        auto right = tpool.run(fib, n - 2);
+        tpool.wait(left);
+        tpool.wait(right);
+        return left.get() + right.get();
+    };
+    expect(tpool.run(fib, 12).get() == 144, "wait: nested wait in a single thread pool");
+
+    const size_t count = 100;
+    auto helped = tpool.run([&]() {
+        atomic<size_t> done(0);
+        for (size_t i = 0; i < count; i++)
+        {
+            tpool.post([&done]() { ++done; });
+        }
+        tpool.help_while([&done, count]() { return done < count; });
+        return done.load();
+    });
+    expect(helped.get() == count, "wait: help_while runs the queued tasks");
+
+    auto pending = tpool.run([&]() {
+        bool ran = false;
+        tpool.post([&ran]() { ran = true; });
+        return tpool.run_pending_task() && ran && !tpool.run_pending_task();
+    });
+    expect(pending.get(), "wait: run_pending_task on the pool");
+
+    // 不是线程池的线程时只是等待
+    auto outside = tpool.run([]() { return 1; });
+    tpool.wait(outside);
+    expect(outside.get() == 1, "wait: wait off the pool");
+    cout << "wait: ok" << endl;
+}
+
+// 后续任务, when_all / when_any, 无共享状态的输入, 以及 TaskGraph 的依赖顺序
+void test_future01()
+{
+    Just::ThreadPool tpool(2);
+
+    auto chained = Just::spawn(tpool, []() { return 20; })
+        .then([](int v) { return v + 1; })
+        .then([](int v) { return v * 2; });
+    expect(chained.get() == 42, "future: then chain");
+
+    auto failed = Just::spawn(tpool, []() -> int { throw runtime_error("boom"); })
+        .then([](int v) { return v + 1; });
+    bool thrown = false;
+    try {
+        failed.get();
+    }
+    catch (const runtime_error&) {
+        thrown = true;
+    }
+    expect(thrown, "future: exception skips the continuation");
+
+    vector<Just::Future<int>> futs;
+    for (int i = 0; i < 10; i++)
+    {
+        futs.push_back(Just::spawn(tpool, [i]() { return i; }));
+    }
+    auto all = Just::when_all(std::move(futs)).get();
+    for (int i = 0; i < 10; i++)
+    {
+        expect(all[i].get() == i, "future: when_all keeps input order");
+    }
+
+    auto pair = Just::when_all(Just::spawn(tpool, []() { return 1; }), Just::spawn(tpool, []() {})).get();
+    expect(std::get<0>(pair).get() == 1, "future: when_all tuple");
+
+    Just::Promise<int> never(&tpool);
+    vector<Just::Future<int>> race;
+    race.push_back(never.get_future());
+    race.push_back(Just::spawn(tpool, []() { return 7; }));
+    auto any = Just::when_any(std::move(race)).get();
+    expect(any.index == 1 && any.futures[1].get() == 7, "future: when_any picks the finished input");
+
+    auto no_state = [](auto&& fn) {
+        try {
+            fn();
+        }
+        catch (const future_error& e) {
+            return e.code() == make_error_code(future_errc::no_state);
+        }
+        return false;
+    };
+    expect(no_state([]() { Just::Future<int>().get(); }), "future: get without state");
+    expect(no_state([]() {
+        vector<Just::Future<int>> inputs(1);
+        Just::when_all(std::move(inputs));
+    }), "future: when_all without state");
+    expect(no_state([&]() { Just::when_any(Just::spawn(tpool, []() { return 1; }), Just::Future<int>()); }),
+           "future: when_any without state");
+
+    // a -> (b, c) -> d, 运行两次
+    mutex order_mutex;
+    vector<char> order;
+    auto record = [&](char name) {
+        return [&order_mutex, &order, name]() {
+            lock_guard<mutex> locker(order_mutex);
+            order.push_back(name);
+        };
+    };
+    Just::TaskGraph graph;
+    auto a = graph.add(record('a'));
+    auto b = graph.add(record('b'));
+    auto c = graph.add(record('c'));
+    auto d = graph.add(record('d'));
+    graph.precede(a, b);
+    graph.precede(a, c);
+    graph.precede(b, d);
+    graph.precede(c, d);
+    for (int i = 0; i < 2; i++)
+    {
+        order.clear();
+        graph.run(tpool).get();
+        expect(order.size() == 4 && order.front() == 'a' && order.back() == 'd', "task graph: dependency order");
+    }
+
+    Just::TaskGraph cycle;
+    auto x = cycle.add([]() {});
+    auto y = cycle.add([]() {});
+    cycle.precede(x, y);
+    cycle.precede(y, x);
+    thrown = false;
+    try {
+        cycle.run(tpool).get();
+    }
+    catch (const logic_error&) {
+        thrown = true;
+    }
+    expect(thrown, "task graph: cycle is rejected");
+    cout << "future: ok" << endl;
+}
+
+#ifdef JUST_HAS_COROUTINES
+Just::task<int> coro_part(Just::ThreadPool& tpool, int v)
+{
+    co_await tpool.schedule();
+    co_return v;
+}
+
+Just::task<void> coro_fail(Just::ThreadPool& tpool)
+{
+    co_await tpool.schedule();
+    throw runtime_error("boom");
+}
+
+Just::task<int> coro_sum(Just::ThreadPool& tpool)
+{
+    co_await tpool.schedule();
+    auto [a, b] = co_await Just::when_all(coro_part(tpool, 1), coro_part(tpool, 2));
+
+    vector<Just::task<int>> parts;
+    for (int i = 0; i < 10; i++)
+    {
+        parts.push_back(coro_part(tpool, i));
+    }
+    vector<int> values = co_await Just::when_all(std::move(parts));
+    for (int i = 0; i < 10; i++)
+    {
+        if (values[i] != i)
+            co_return -1;
+    }
+
+    int c = co_await Just::spawn(tpool, []() { return 100; });
+    co_return a + b + accumulate(values.begin(), values.end(), 0) + c;
+}
+
+// 协程: schedule 切换到线程池, when_all 的结果顺序, co_await Future, 异常传给 sync_wait
+void test_coroutine01()
+{
+    Just::ThreadPool tpool(2);
+    expect(Just::sync_wait(coro_sum(tpool)) == 1 + 2 + 45 + 100, "coroutine: when_all and co_await future");
+
+    bool thrown = false;
+    try {
+        Just::sync_wait(coro_fail(tpool));
+    }
+    catch (const runtime_error&) {
+        thrown = true;
+    }
+    expect(thrown, "coroutine: exception reaches sync_wait");
+    cout << "coroutine: ok" << endl;
+}
+#endif
+
+// 任务追踪: 以 JUST_ENABLE_TRACE 编译时, 每个任务导出一个执行区间和一对入队到开始的 flow 事件
+void test_trace01()
+{
+    const size_t count = 1000;
+    const char* path = "test_trace01.json";
+    Just::ThreadPool tpool(2);
+    tpool.set_tracing(true);
+
+    vector<future<void>> futs;
+    for (size_t i = 0; i < count; i++)
+    {
+        futs.emplace_back(tpool.run([]() {}));
+    }
+    for (auto& it : futs)
+    {
+        it.get();
+    }
+    // future 就绪时任务的事件可能还没写入, 先等线程退出; 缓冲区在 stop 后保留
+    tpool.stop();
+
+    if (!tpool.dump_trace(path))
+    {
+        cout << "trace: not compiled in (JUST_ENABLE_TRACE)" << endl;
+        return;
+    }
+
+    stringstream text;
+    text << ifstream(path).rdbuf();
+    string json = text.str();
+    remove(path);
+
+    auto occurrences = [&json](const string& pattern) {
+        size_t n = 0;
+        for (size_t pos = json.find(pattern); pos != string::npos; pos = json.find(pattern, pos + pattern.size()))
+        {
+            ++n;
+        }
+        return n;
+    };
+    expect(json.find("{\"displayTimeUnit\"") == 0 && json.find("]}") != string::npos, "trace: json document");
+    expect(occurrences("\"name\":\"task\"") == count, "trace: one slice per task");
+    expect(occurrences("\"ph\":\"s\"") == count && occurrences("\"ph\":\"f\"") == count, "trace: one flow per task");
+    cout << "trace: ok" << endl;
+}
+
+// 扇出 Count 个小任务: run / post / post_bulk
+template<const size_t Count = 10000>
+void test_pool02()
+{
+    Just::ThreadPool tpool;
+    atomic<size_t> done_num(0);
+    auto job = [&done_num]() { ++done_num; };
+
+    auto wait_done = [&done_num]() {
+        while (done_num < Count)
+        {
+            this_thread::yield();
+        }
+        done_num = 0;
+    };
+
+    auto begin = chrono::steady_clock::now();
+    vector<future<void>> futs;
+    futs.reserve(Count);
+    for (size_t i = 0; i < Count; i++)
+    {
+        futs.emplace_back(tpool.run(job));
+    }
+    wait_done();
+    auto end = chrono::steady_clock::now();
+    cout << "run: " << chrono::duration_cast<chrono::microseconds>(end - begin).count() << "us" << endl;
+
+    begin = chrono::steady_clock::now();
+    for (size_t i = 0; i < Count; i++)
+    {
+        tpool.post(job);
+    }
+    wait_done();
+    end = chrono::steady_clock::now();
+    cout << "post: " << chrono::duration_cast<chrono::microseconds>(end - begin).count() << "us" << endl;
+
+    vector<decltype(job)> jobs(Count, job);
+    begin = chrono::steady_clock::now();
+    tpool.post_bulk(jobs.begin(), jobs.end());
+    wait_done();
+    end = chrono::steady_clock::now();
+    cout << "post_bulk: " << chrono::duration_cast<chrono::microseconds>(end - begin).count() << "us" << endl;
+}
+
+// 数据并行算法与串行对比: 内存密集 (transform / 求和) 与计算密集且开销不均 (第 i 项迭代 i % 1024 次)
+template<const size_t Count = COUNT>
+void test_parallel01()
+{
+    Just::ThreadPool tpool;
+    vector<double> in(Count, 1.5);
+    vector<double> out(Count);
+
+    auto timed = [](const char* name, auto&& fn) {
+        auto begin = chrono::steady_clock::now();
+        fn();
+        auto end = chrono::steady_clock::now();
+        cout << name << ": " << chrono::duration_cast<chrono::microseconds>(end - begin).count() << "us" << endl;
+    };
+    auto heavy = [](size_t i) {
+        double x = static_cast<double>(i);
+        for (size_t k = 0; k < i % 1024; k++)
+        {
+            x = sqrt(x + 1.0);
+        }
+        return x;
+    };
+
+    timed("serial transform", [&]() { transform(in.begin(), in.end(), out.begin(), [](double x) { return x * 2.0 + 1.0; }); });
+    timed("parallel_transform", [&]() {
+        Just::parallel_transform(tpool, in.begin(), in.end(), out.begin(), 0, [](double x) { return x * 2.0 + 1.0; });
+    });
+
+    double sum = 0;
+    timed("serial sum", [&]() { sum = accumulate(in.begin(), in.end(), 0.0); });
+    timed("parallel_reduce sum", [&]() {
+        sum = Just::parallel_reduce(tpool, size_t(0), in.size(), 0, 0.0,
+                                    [&in](size_t i) { return in[i]; }, [](double a, double b) { return a + b; });
+    });
+
+    const size_t heavy_count = Count / 100;
+    timed("serial skewed", [&]() {
+        for (size_t i = 0; i < heavy_count; i++)
+        {
+            out[i] = heavy(i);
+        }
+    });
+    timed("parallel_for skewed", [&]() {
+        Just::parallel_for(tpool, size_t(0), heavy_count, 0, [&](size_t i) { out[i] = heavy(i); });
+    });
+    cout << "sum: " << sum << endl;
+}
+
+// 空任务的平均耗时 (含统计开销), 以及 metrics() 快照
+template<const size_t Count = COUNT / 10>
+void test_metrics01()
+{
+    Just::ThreadPool tpool(1);
+    atomic<size_t> done_num(0);
+    promise<void> finished;
+
+    auto begin = chrono::steady_clock::now();
+    tpool.post([&]() {
+        // 在线程池内部提交, 只测量入队, 出队与统计本身
+        for (size_t i = 0; i < Count; i++)
+        {
+            tpool.post([&]() {
+                if (++done_num == Count)
+                    finished.set_value();
+            });
+        }
+    });
+    finished.get_future().wait();
+    auto end = chrono::steady_clock::now();
+    cout << "empty task: " << chrono::duration<double, nano>(end - begin).count() / Count << "ns" << endl;
+
+    Just::PoolMetrics m = tpool.metrics();
+    cout << "tasks: " << m.total.tasks
+         << " busy: " << m.total.busy_ns / 1000 << "us"
+         << " idle: " << m.total.idle_ns / 1000 << "us"
+         << " parked: " << m.total.parked_ns / 1000 << "us"
+         << " failed pops: " << m.total.failed_pops
+         << " utilization: " << m.total.utilization() << endl;
+    cout << "queue wait (1/" << m.sample_interval << " sampled) p50: " << m.queue_wait.percentile(0.5)
+         << "ns p99: " << m.queue_wait.percentile(0.99) << "ns"
+         << " execution p50: " << m.execution.percentile(0.5)
+         << "ns p99: " << m.execution.percentile(0.99) << "ns" << endl;
+}
+
+// 10 万个按键串行的执行单元: 每个键一个 Strand, 对比每个键一把 mutex
+template<const size_t Keys = 100000, const size_t Count = COUNT / 10>
+void test_strand01()
+{
+    Just::ThreadPool tpool;
+    vector<size_t> keys(Count);
+    uint32_t seed = 2463534242u;
+    for (auto& it : keys)
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        it = seed % Keys;
+    }
+
+    auto timed = [&](const char* name, auto&& submit) {
+        vector<uint64_t> counter(Keys, 0);
+        atomic<size_t> done_num(0);
+        promise<void> finished;
+        auto begin = chrono::steady_clock::now();
+        vector<thread> producers;
+        for (size_t p = 0; p < PUSH_THREADS; p++)
+        {
+            producers.emplace_back([&, p]() {
+                for (size_t i = p; i < Count; i += PUSH_THREADS)
+                {
+                    size_t key = keys[i];
+                    submit(key, [&counter, &done_num, &finished, key]() {
+                        ++counter[key];
+                        if (++done_num == Count)
+                            finished.set_value();
+                    });
+                }
+            });
+        }
+        for (auto& it : producers)
+        {
+            it.join();
+        }
+        finished.get_future().wait();
+        auto end = chrono::steady_clock::now();
+        cout << name << ": " << chrono::duration<double, nano>(end - begin).count() / Count << "ns/task" << endl;
+    };
+
+    vector<Just::Strand> strands;
+    strands.reserve(Keys);
+    for (size_t i = 0; i < Keys; i++)
+    {
+        strands.emplace_back(tpool);
+    }
+    timed("strand", [&](size_t key, auto&& fn) { strands[key].post(std::move(fn)); });
+
+    unique_ptr<mutex[]> locks(new mutex[Keys]);
+    timed("mutex", [&](size_t key, auto&& fn) {
+        tpool.post([&locks, key, fn]() mutable {
+            lock_guard<mutex> locker(locks[key]);
+            fn();
+        });
+    });
+    // 最后一个任务可能还在释放锁, 先等线程退出再析构 strands 与 locks
+    tpool.stop();
+}
+
+// 空任务的平均耗时: 编译期组合的 BasicThreadPool 与 ThreadPool
+template<const size_t Count = COUNT / 10>
+void test_basic01()
+{
+    auto timed = [](const char* name, auto& tpool) {
+        atomic<size_t> done_num(0);
+        promise<void> finished;
+        auto begin = chrono::steady_clock::now();
+        tpool.post([&]() {
+            for (size_t i = 0; i < Count; i++)
+            {
+                tpool.post([&]() {
+                    if (++done_num == Count)
+                        finished.set_value();
+                });
+            }
+        });
+        finished.get_future().wait();
+        auto end = chrono::steady_clock::now();
+        cout << name << ": " << chrono::duration<double, nano>(end - begin).count() / Count << "ns/task" << endl;
+    };
+
+    {
+        Just::BasicThreadPool<> tpool(2);
+        timed("BasicThreadPool<LinkedQueue>", tpool);
+    }
+    {
+        Just::BasicThreadPool<Just::policy::BlockQueue> tpool(2);
+        timed("BasicThreadPool<BlockQueue>", tpool);
+    }
+    {
+        Just::BasicThreadPool<Just::policy::RingQueue<>> tpool(2);
+        timed("BasicThreadPool<RingQueue>", tpool);
+    }
+    {
+        Just::BasicThreadPool<Just::policy::LinkedQueue, function<void()>, Just::SpinPark, Just::policy::CountMetrics> tpool(2);
+        timed("BasicThreadPool<LinkedQueue, function, CountMetrics>", tpool);
+    }
+    {
+        // 与 ThreadPool 相同的队列, 空闲与统计策略
+        Just::BasicThreadPool<Just::policy::LinkedQueue, Just::Task, Just::DynamicIdle, Just::policy::TimedMetrics> tpool(2);
+        timed("BasicThreadPool<LinkedQueue, Task, DynamicIdle, TimedMetrics>", tpool);
+    }
+    {
+        Just::ThreadPool tpool(2, Just::ThreadPool::Scheduler::Shared);
+        timed("ThreadPool", tpool);
+    }
+}
+
+// 各空闲策略的唤醒延迟与空闲时消耗的 CPU 时间
+void test_idle01()
+{
+    using Idle = Just::ThreadPool::IdleStrategy;
+    const pair<const char*, Idle> strategies[] = {
+        { "SpinPark", Idle::SpinPark },
+        { "BusySpin", Idle::BusySpin },
+        { "Backoff", Idle::Backoff },
+        { "Block", Idle::Block },
+    };
+    const size_t rounds = 200;
+
+    auto cpu_us = []() {
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000LL + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+    };
+
+    for (auto& it : strategies)
+    {
+        Just::ThreadPool::Options opts;
+        opts.thread_hint = 2;
+        opts.idle = it.second;
+        Just::ThreadPool tpool(opts);
+
+        // 空闲期间的 CPU 占用
+        this_thread::sleep_for(chrono::milliseconds(50));
+        auto cpu_begin = cpu_us();
+        auto wall_begin = chrono::steady_clock::now();
+        this_thread::sleep_for(chrono::milliseconds(200));
+        double cpu = static_cast<double>(cpu_us() - cpu_begin)
+                   / chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - wall_begin).count();
+
+        // 空闲一段时间后提交, 到任务开始执行的延迟
+        vector<int64_t> latency;
+        for (size_t i = 0; i < rounds; i++)
+        {
+            this_thread::sleep_for(chrono::milliseconds(2));
+            promise<chrono::steady_clock::time_point> started;
+            auto begin = chrono::steady_clock::now();
+            tpool.post([&]() { started.set_value(chrono::steady_clock::now()); });
+            auto end = started.get_future().get();
+            latency.push_back(chrono::duration_cast<chrono::nanoseconds>(end - begin).count());
+        }
+        sort(latency.begin(), latency.end());
+        cout << it.first << ": idle cpu " << cpu * 100 << "%"
+             << " wake p50 " << latency[rounds / 2] / 1000.0 << "us"
+             << " p99 " << latency[rounds * 99 / 100] / 1000.0 << "us" << endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    test_slots01();
+    test_pool03();
+    test_timer01();
+    test_resize01();
+    test_cancel01();
+    test_wait01();
+    test_future01();
+    test_trace01();
+#ifdef JUST_HAS_COROUTINES
+    test_coroutine01();
+#endif
+
+    test_pool01();
+    test_pool02();
+    test_parallel01();
+    test_metrics01();
+    test_strand01();
+    test_basic01();
+    test_idle01();
+
+    test_queue05<int>();
+    test_queue05_bulk<int>();
+    test_queue06<int>();
+
+    test_spsc01<int>();
+    test_spsc01<int, COUNT, BULK_SIZE>();
+    test_spsc02();
 
     printf("%ld\n", sizeof(std::atomic_bool));
 